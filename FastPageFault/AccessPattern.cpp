@@ -0,0 +1,132 @@
+#include "stdafx.h"
+#include "AccessPattern.h"
+#include <random>
+#include "Histogram.h"
+#include "TickCounter.h"
+
+bool AccessPattern::Parse(const std::wstring &str, AccessPattern &pattern)
+{
+	if (str == L"sequential") { pattern._Kind = Kind::Sequential; }
+	else if (str == L"reverse") { pattern._Kind = Kind::Reverse; }
+	else if (str == L"random") { pattern._Kind = Kind::Random; }
+	else if (str == L"interleaved") { pattern._Kind = Kind::Interleaved; }
+	else if (str.compare(0, 7, L"stride:") == 0)
+	{
+		long stride = wcstol(str.c_str() + 7, nullptr, 10);
+		if (stride < 1)
+		{
+			return false;
+		}
+		pattern._Kind = Kind::Stride;
+		pattern._StridePages = (size_t)stride;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+const wchar_t *AccessPattern::ToString() const
+{
+	switch (_Kind)
+	{
+	case Kind::Reverse: return L"reverse";
+	case Kind::Stride: return L"stride";
+	case Kind::Random: return L"random";
+	case Kind::Interleaved: return L"interleaved";
+	default: return L"sequential";
+	}
+}
+
+void AccessPattern::Prepare(size_t totalBytes, size_t pageBytes, int threads)
+{
+	_PageBytes = pageBytes;
+	_Pages = totalBytes / pageBytes;
+	_Threads = threads < 1 ? 1 : threads;
+
+	if (_Kind == Kind::Random && _Permutation.size() != _Pages)
+	{
+		_Permutation.resize(_Pages);
+		for (size_t i = 0; i < _Pages; i++)
+		{
+			_Permutation[i] = (uint32_t)i;
+		}
+		std::mt19937_64 rng(0x5eed); // fixed seed to get the same order in every run
+		std::shuffle(_Permutation.begin(), _Permutation.end(), rng);
+	}
+}
+
+size_t AccessPattern::GetThreadBytes(int thread) const
+{
+	if (_Kind == Kind::Interleaved)
+	{
+		return thread < (int)_Pages ? ((_Pages - thread + _Threads - 1) / _Threads) * _PageBytes : 0;
+	}
+	return (SliceEnd(thread) - SliceStart(thread)) * _PageBytes;
+}
+
+std::vector<size_t> AccessPattern::GetSampleOffsets(int thread, size_t maxSamples) const
+{
+	size_t pages = GetThreadBytes(thread) / _PageBytes;
+	size_t step = pages > maxSamples ? pages / maxSamples : 1;
+
+	std::vector<size_t> offsets;
+	size_t index = 0;
+	ForEachPage(thread, [&](size_t offset)
+	{
+		if (index++ % step == 0)
+		{
+			offsets.push_back(offset);
+		}
+	});
+	return offsets;
+}
+
+template<typename F>
+static void TouchEachPage(const AccessPattern &pattern, int thread, Histogram *pHistogram, F access)
+{
+	if (pHistogram == nullptr)
+	{
+		pattern.ForEachPage(thread, access);
+		return;
+	}
+
+	pattern.ForEachPage(thread, [&](size_t offset)
+	{
+		uint64_t start = TickCounter::Now();
+		access(offset);
+		pHistogram->Record(TickCounter::Now() - start);
+	});
+}
+
+// The page accesses have no observable side effect for the compiler. The volatile pointer and the disabled
+// optimizations make sure that every page is really accessed.
+#pragma optimize( "", off )
+void AccessPattern::Touch(void *p, int thread, PageAccess access, Histogram *pHistogram) const
+{
+	volatile char *pB = (char *)p;
+	char tmp;
+	switch (access)
+	{
+	case PageAccess::Read:
+		TouchEachPage(*this, thread, pHistogram, [&](size_t offset) { tmp = pB[offset]; });
+		break;
+	case PageAccess::Write:
+		TouchEachPage(*this, thread, pHistogram, [&](size_t offset) { pB[offset] = 1; });
+		break;
+	case PageAccess::Rmw:
+		TouchEachPage(*this, thread, pHistogram, [&](size_t offset) { pB[offset] = pB[offset] + 1; });
+		break;
+	}
+}
+
+void AccessPattern::TouchWrite(void *p, size_t n, size_t stride)
+{
+	volatile char *pB = (char *)p;
+	for (size_t i = 0; i < n; i += stride)
+	{
+		pB[i] = 1;
+	}
+}
+#pragma optimize("", on)
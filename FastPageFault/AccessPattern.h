@@ -0,0 +1,104 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Histogram;
+
+// What is done with the first byte of every touched page
+enum class PageAccess
+{
+	Read = 0,   // load: maps the shared zero page for fresh anonymous memory on Linux
+	Write,      // store: allocates and zeroes a new page or copies a private file page
+	Rmw,        // load followed by a store to the same byte
+};
+
+// Order in which the pages of a buffer are touched and how they are distributed over the touching threads.
+// Sequential, Reverse and Stride split the buffer into one contiguous slice per thread. Random distributes a precomputed
+// random permutation of all pages over the threads and Interleaved assigns page i to thread i % threads.
+// Prepare must be called outside of the measured region since the random permutation is computed there.
+class AccessPattern
+{
+public:
+	enum class Kind
+	{
+		Sequential = 0,
+		Reverse,
+		Stride,
+		Random,
+		Interleaved,
+	};
+
+	static bool Parse(const std::wstring &str, AccessPattern &pattern);
+	const wchar_t *ToString() const;
+	Kind GetKind() const { return _Kind; }
+
+	// Set up the pattern for a buffer of totalBytes which is touched every pageBytes by the given number of threads
+	void Prepare(size_t totalBytes, size_t pageBytes, int threads);
+
+	// Call f(byteOffset) for every page the thread has to touch in the order of the pattern
+	template<typename F>
+	void ForEachPage(int thread, F f) const
+	{
+		switch (_Kind)
+		{
+		case Kind::Sequential:
+			for (size_t page = SliceStart(thread); page < SliceEnd(thread); page++)
+			{
+				f(page * _PageBytes);
+			}
+			break;
+		case Kind::Reverse:
+			for (size_t page = SliceEnd(thread); page > SliceStart(thread); page--)
+			{
+				f((page - 1) * _PageBytes);
+			}
+			break;
+		case Kind::Stride:
+			for (size_t offset = 0; offset < _StridePages; offset++)
+			{
+				for (size_t page = SliceStart(thread) + offset; page < SliceEnd(thread); page += _StridePages)
+				{
+					f(page * _PageBytes);
+				}
+			}
+			break;
+		case Kind::Random:
+			for (size_t i = SliceStart(thread); i < SliceEnd(thread); i++)
+			{
+				f((size_t)_Permutation[i] * _PageBytes);
+			}
+			break;
+		case Kind::Interleaved:
+			for (size_t page = thread; page < _Pages; page += _Threads)
+			{
+				f(page * _PageBytes);
+			}
+			break;
+		}
+	}
+
+	// Access the pages of the thread in the order of the pattern. When pHistogram is given every page access is timed with TickCounter.
+	void Touch(void *p, int thread, PageAccess access, Histogram *pHistogram) const;
+
+	// Write the first byte of every stride bytes of [p, p+n) in ascending order to fault in every page
+	static void TouchWrite(void *p, size_t n, size_t stride);
+
+	// Number of bytes which are touched by the thread
+	size_t GetThreadBytes(int thread) const;
+
+	// Up to maxSamples evenly distributed offsets of the pages of the thread (used to check the NUMA placement)
+	std::vector<size_t> GetSampleOffsets(int thread, size_t maxSamples) const;
+
+private:
+	size_t SliceStart(int thread) const { return _Pages * thread / _Threads; }
+	size_t SliceEnd(int thread) const { return _Pages * (thread + 1) / _Threads; }
+
+	Kind _Kind = Kind::Sequential;
+	size_t _StridePages = 1;
+	size_t _Pages = 0;
+	size_t _PageBytes = 4096;
+	int _Threads = 1;
+	std::vector<uint32_t> _Permutation;
+};
@@ -0,0 +1,134 @@
+#include "stdafx.h"
+#include "Allocator.h"
+#include "Platform.h"
+#include <cstdlib>
+
+bool Allocator::Parse(const std::wstring &str, Config &config)
+{
+	config = Config();
+	if (str == L"mmap") { config.Kind = Strategy::Mmap; }
+	else if (str == L"arena") { config.Kind = Strategy::Arena; }
+	else if (str == L"dontneed") { config.Kind = Strategy::DontNeed; }
+	else if (str == L"free") { config.Kind = Strategy::Free; }
+	else if (str == L"malloc") { config.Kind = Strategy::Malloc; }
+	else if (str.compare(0, 7, L"malloc:") == 0)
+	{
+		int trimMB = 0;
+		if (swscanf(str.c_str() + 7, L"%d", &trimMB) != 1 || trimMB <= 0)
+		{
+			return false;
+		}
+		config.Kind = Strategy::Malloc;
+		config.TrimBytes = (size_t)trimMB * 1024 * 1024;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+std::wstring Allocator::ToString(const Config &config)
+{
+	switch (config.Kind)
+	{
+	case Strategy::Mmap: return L"mmap";
+	case Strategy::Arena: return L"arena";
+	case Strategy::DontNeed: return L"dontneed";
+	case Strategy::Free: return L"free";
+	case Strategy::Malloc: return config.TrimBytes == 0 ? L"malloc" : StringExtensions::Format(L"malloc:%zu", config.TrimBytes / (1024 * 1024));
+	}
+	return L"unknown";
+}
+
+bool Allocator::IsSupported(const Config &config)
+{
+#ifdef _WIN32
+	return config.TrimBytes == 0;
+#else
+	(void)config;
+	return true;
+#endif
+}
+
+// A trim threshold also serves all blocks up to the maximum glibc mmap threshold (32 MB) from the heap. Otherwise setting it
+// would fix the mmap threshold at 128 KB and every larger block would be mapped like with the mmap strategy.
+// The destructor restores the default thresholds but glibc cannot turn its dynamic thresholds back on.
+Allocator::Allocator(const Config &config, size_t capacity) : _Config(config), _Capacity(capacity)
+{
+	if (_Config.Kind == Strategy::Arena || _Config.Kind == Strategy::DontNeed || _Config.Kind == Strategy::Free)
+	{
+		_pArena = (char *)Platform::Allocate(_Capacity);
+	}
+	else if (_Config.Kind == Strategy::Malloc && _Config.TrimBytes > 0)
+	{
+		Platform::SetHeapThresholds(_Config.TrimBytes, 32 * 1024 * 1024);
+	}
+}
+
+Allocator::~Allocator()
+{
+	Reset();
+	if (_pArena != nullptr)
+	{
+		Platform::Free(_pArena, _Capacity);
+	}
+	if (_Config.Kind == Strategy::Malloc)
+	{
+		if (_Config.TrimBytes > 0)
+		{
+			Platform::ResetHeapThresholds();
+		}
+		// start the next strategy without the memory which glibc kept
+		Platform::TrimHeap();
+	}
+}
+
+void *Allocator::Allocate(size_t n)
+{
+	void *p = nullptr;
+	switch (_Config.Kind)
+	{
+	case Strategy::Mmap:
+		p = Platform::Allocate(n);
+		break;
+	case Strategy::Malloc:
+		p = malloc(n);
+		break;
+	default:
+		if (_pArena != nullptr && _Used + n <= _Capacity)
+		{
+			p = _pArena + _Used;
+			_Used += (n + 63) / 64 * 64;
+		}
+		return p;
+	}
+
+	if (p != nullptr)
+	{
+		_Blocks.push_back(std::make_pair(p, n));
+	}
+	return p;
+}
+
+void Allocator::Reset()
+{
+	for (auto &block : _Blocks)
+	{
+		if (_Config.Kind == Strategy::Mmap)
+		{
+			Platform::Free(block.first, block.second);
+		}
+		else
+		{
+			free(block.first);
+		}
+	}
+	_Blocks.clear();
+
+	if (_pArena != nullptr && _Used > 0 && _Config.Kind != Strategy::Arena)
+	{
+		Platform::Discard(_pArena, (_Used + Platform::GetPageSize() - 1) / Platform::GetPageSize() * Platform::GetPageSize(), _Config.Kind == Strategy::Free);
+	}
+	_Used = 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Allocation strategies for a workload which allocates many blocks, uses them and releases all of them at the end of an
+// iteration. They differ in how much memory is reused between iterations and therefore how often the pages fault again.
+class Allocator
+{
+public:
+	enum class Strategy
+	{
+		Mmap = 0,   // map every block and unmap it at the end of the iteration
+		Arena,      // bump allocate from one retained arena which is only reset
+		DontNeed,   // arena whose pages are discarded on reset (MADV_DONTNEED / decommit)
+		Free,       // arena whose pages are discarded lazily on reset (MADV_FREE / MEM_RESET)
+		Malloc,     // malloc and free every block
+	};
+
+	struct Config
+	{
+		Strategy Kind = Strategy::Mmap;
+		size_t TrimBytes = 0;   // Malloc only: M_TRIM_THRESHOLD, 0 keeps the dynamic glibc thresholds. Must run after the plain Malloc strategies.
+	};
+
+	// Parse mmap, arena, dontneed, free, malloc or malloc:trimMB
+	static bool Parse(const std::wstring &str, Config &config);
+	static std::wstring ToString(const Config &config);
+	static bool IsSupported(const Config &config);
+
+	// capacity is the maximum number of bytes which are allocated in one iteration. Arena strategies allocate it up front.
+	Allocator(const Config &config, size_t capacity);
+	~Allocator();
+
+	// Returns nullptr when the allocation failed
+	void *Allocate(size_t n);
+	// Release all blocks of the iteration
+	void Reset();
+
+private:
+	Allocator(const Allocator &) = delete;
+	Allocator &operator=(const Allocator &) = delete;
+
+	Config _Config;
+	size_t _Capacity;
+	char *_pArena = nullptr;
+	size_t _Used = 0;
+	std::vector<std::pair<void *, size_t>> _Blocks;   // Mmap and Malloc
+};
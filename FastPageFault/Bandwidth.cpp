@@ -0,0 +1,106 @@
+#include "stdafx.h"
+#include "Bandwidth.h"
+
+namespace
+{
+	const double Scalar = 3.0;
+
+	// the sum of the read kernel is stored here so the compiler cannot remove the loads
+	volatile double ReadSink = 0;
+}
+
+bool Bandwidth::Parse(const std::wstring &str, Kernel &kernel)
+{
+	if (str == L"read") { kernel = Kernel::Read; }
+	else if (str == L"write") { kernel = Kernel::Write; }
+	else if (str == L"copy") { kernel = Kernel::Copy; }
+	else if (str == L"scale") { kernel = Kernel::Scale; }
+	else if (str == L"triad") { kernel = Kernel::Triad; }
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+const wchar_t *Bandwidth::ToString(Kernel kernel)
+{
+	switch (kernel)
+	{
+	case Kernel::Read: return L"read";
+	case Kernel::Write: return L"write";
+	case Kernel::Copy: return L"copy";
+	case Kernel::Scale: return L"scale";
+	case Kernel::Triad: return L"triad";
+	}
+	return L"unknown";
+}
+
+size_t Bandwidth::BytesPerElement(Kernel kernel)
+{
+	switch (kernel)
+	{
+	case Kernel::Read:
+	case Kernel::Write:
+		return sizeof(double);
+	case Kernel::Copy:
+	case Kernel::Scale:
+		return 2 * sizeof(double);
+	case Kernel::Triad:
+		return 3 * sizeof(double);
+	}
+	return 0;
+}
+
+void Bandwidth::Run(Kernel kernel, double *a, double *b, double *c, size_t begin, size_t end, int iterations)
+{
+	for (int i = 0; i < iterations; i++)
+	{
+		switch (kernel)
+		{
+		case Kernel::Read:
+		{
+			// independent partial sums. A single sum would be limited by the latency of the floating point add.
+			double sums[8] = {};
+			size_t j = begin;
+			for (; j + 8 <= end; j += 8)
+			{
+				for (int k = 0; k < 8; k++)
+				{
+					sums[k] += a[j + k];
+				}
+			}
+			for (; j < end; j++)
+			{
+				sums[0] += a[j];
+			}
+			ReadSink = sums[0] + sums[1] + sums[2] + sums[3] + sums[4] + sums[5] + sums[6] + sums[7];
+			break;
+		}
+		case Kernel::Write:
+			for (size_t j = begin; j < end; j++)
+			{
+				a[j] = Scalar;
+			}
+			break;
+		case Kernel::Copy:
+			for (size_t j = begin; j < end; j++)
+			{
+				c[j] = a[j];
+			}
+			break;
+		case Kernel::Scale:
+			for (size_t j = begin; j < end; j++)
+			{
+				b[j] = Scalar * c[j];
+			}
+			break;
+		case Kernel::Triad:
+			for (size_t j = begin; j < end; j++)
+			{
+				a[j] = b[j] + Scalar * c[j];
+			}
+			break;
+		}
+	}
+}
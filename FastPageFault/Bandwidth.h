@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// STREAM style kernels on arrays of doubles to measure the sustainable memory bandwidth. The bytes of a kernel are counted
+// like STREAM does: every array element which is read or written once per iteration counts 8 bytes. Write allocate traffic
+// (reading the destination cache line before it is written) is not counted.
+class Bandwidth
+{
+public:
+	enum class Kernel
+	{
+		Read = 0,   // sum += a[j]
+		Write,      // a[j] = scalar
+		Copy,       // c[j] = a[j]
+		Scale,      // b[j] = scalar * c[j]
+		Triad,      // a[j] = b[j] + scalar * c[j]
+	};
+
+	// Parse read, write, copy, scale or triad
+	static bool Parse(const std::wstring &str, Kernel &kernel);
+	static const wchar_t *ToString(Kernel kernel);
+	// Bytes which are read and written per element and iteration
+	static size_t BytesPerElement(Kernel kernel);
+
+	// Execute kernel iterations times over the elements [begin, end) of the arrays a, b and c
+	static void Run(Kernel kernel, double *a, double *b, double *c, size_t begin, size_t end, int iterations);
+};
@@ -0,0 +1,138 @@
+#include "stdafx.h"
+#include "CacheState.h"
+#include <random>
+
+static const int EvictRetries = 3;
+
+bool CacheState::Parse(const std::wstring &str, double &residentPercent, Layout &layout)
+{
+	size_t pos = str.find(L':');
+	std::wstring name = pos == std::wstring::npos ? L"head" : str.substr(pos + 1);
+	if (name == L"head") { layout = Layout::Head; }
+	else if (name == L"tail") { layout = Layout::Tail; }
+	else if (name == L"interleaved") { layout = Layout::Interleaved; }
+	else if (name == L"random") { layout = Layout::Random; }
+	else
+	{
+		return false;
+	}
+
+	wchar_t *pEnd = nullptr;
+	std::wstring percent = str.substr(0, pos);
+	residentPercent = wcstod(percent.c_str(), &pEnd);
+	return !percent.empty() && *pEnd == 0 && residentPercent >= 0 && residentPercent <= 100;
+}
+
+const wchar_t *CacheState::ToString(Layout layout)
+{
+	switch (layout)
+	{
+	case Layout::Tail: return L"tail";
+	case Layout::Interleaved: return L"interleaved";
+	case Layout::Random: return L"random";
+	default: return L"head";
+	}
+}
+
+double CacheState::GetResidentFraction(const std::wstring &file)
+{
+	return Platform::GetFileResidentFraction(file);
+}
+
+// Pages which are mapped by a process or are under writeback survive the first flush
+bool CacheState::Evict(const std::wstring &file)
+{
+	for (int i = 0; i < EvictRetries; i++)
+	{
+		if (!Platform::FlushFileCache(file))
+		{
+			return false;
+		}
+
+		double resident = GetResidentFraction(file);
+		if (resident <= 0) // unknown residency is treated as success
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// The pages are read with the random access handle of OpenFileForRead so that the read ahead does not pull in more pages
+// than selected. Adjacent selected pages are read with one call.
+bool CacheState::Prepare(const std::wstring &file, double residentPercent, Layout layout)
+{
+	if (!Evict(file))
+	{
+		return false;
+	}
+
+	Platform::FileHandle hFile = Platform::OpenFileForRead(file);
+	size_t fileSize = 0;
+	if (hFile == Platform::InvalidFile || !Platform::GetFileSize(hFile, fileSize))
+	{
+		Platform::CloseFile(hFile);
+		return false;
+	}
+
+	const size_t pageSize = Platform::GetPageSize();
+	const size_t pages = (fileSize + pageSize - 1) / pageSize;
+	const size_t residentPages = (size_t)(pages * residentPercent / 100 + 0.5);
+
+	std::vector<bool> selected(pages, false);
+	switch (layout)
+	{
+	case Layout::Head:
+		std::fill(selected.begin(), selected.begin() + residentPages, true);
+		break;
+	case Layout::Tail:
+		std::fill(selected.end() - residentPages, selected.end(), true);
+		break;
+	case Layout::Interleaved:
+		for (size_t i = 0; i < pages; i++)
+		{
+			selected[i] = (i + 1) * residentPages / pages > i * residentPages / pages; // spread the pages evenly
+		}
+		break;
+	case Layout::Random:
+	{
+		std::vector<size_t> permutation(pages);
+		for (size_t i = 0; i < pages; i++)
+		{
+			permutation[i] = i;
+		}
+		std::mt19937_64 rng(0x5eed); // fixed seed to get the same pages in every run
+		std::shuffle(permutation.begin(), permutation.end(), rng);
+		for (size_t i = 0; i < residentPages; i++)
+		{
+			selected[permutation[i]] = true;
+		}
+		break;
+	}
+	}
+
+	const size_t maxRead = 1024 * 1024;
+	std::vector<char> buffer(maxRead);
+	bool lret = true;
+	for (size_t page = 0; page < pages && lret; )
+	{
+		if (!selected[page])
+		{
+			page++;
+			continue;
+		}
+
+		size_t end = page;
+		while (end < pages && selected[end] && (end - page) * pageSize < maxRead)
+		{
+			end++;
+		}
+
+		size_t read = 0;
+		lret = Platform::ReadFileAt(hFile, buffer.data(), (end - page) * pageSize, (uint64_t)page * pageSize, read);
+		page = end;
+	}
+
+	Platform::CloseFile(hFile);
+	return lret;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+
+// Puts a file into a known file system cache state before a trial. Evict drops only the pages of the file and checks
+// with mincore that they are gone. Prepare evicts the file and reads a percentage of its pages back in so that the
+// trial starts with a partially warm cache e.g. after a deploy where only parts of the data files were read.
+class CacheState
+{
+public:
+	// Which pages of the file stay resident for a partial cache state
+	enum class Layout
+	{
+		Head = 0,       // the first pages of the file
+		Tail,           // the last pages of the file
+		Interleaved,    // evenly spread over the file
+		Random,         // random pages (fixed seed)
+	};
+
+	// Parse pct[:layout] where layout is head (default), tail, interleaved or random
+	static bool Parse(const std::wstring &str, double &residentPercent, Layout &layout);
+	static const wchar_t *ToString(Layout layout);
+
+	// Evict the file from the file system cache. The eviction is repeated while pages remain resident.
+	// Returns false when the file could not be flushed or pages are still resident.
+	static bool Evict(const std::wstring &file);
+	// Evict the file and read residentPercent of its pages in the given layout into the file system cache
+	static bool Prepare(const std::wstring &file, double residentPercent, Layout layout);
+	// Fraction (0-1) of the file in the file system cache, -1 when this cannot be determined (Windows)
+	static double GetResidentFraction(const std::wstring &file);
+};
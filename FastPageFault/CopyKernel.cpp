@@ -0,0 +1,228 @@
+#include "stdafx.h"
+#include "CopyKernel.h"
+#include "Platform.h"
+#include <cstring>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#include <immintrin.h>
+#define FASTPAGEFAULT_HAS_SIMD 1
+#define FASTPAGEFAULT_TARGET(isa)
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <immintrin.h>
+#define FASTPAGEFAULT_HAS_SIMD 1
+// compile a single function for isa without raising the instruction set of the whole program
+#define FASTPAGEFAULT_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace
+{
+	const size_t BlockBytes = 256;   // bytes copied by one iteration of the SIMD loops
+
+	void CopyMemcpy(void *pDest, const void *pSource, size_t n)
+	{
+		memcpy(pDest, pSource, n);
+	}
+
+	void CopyPrefault(void *pDest, const void *pSource, size_t n)
+	{
+		const size_t pageSize = Platform::GetPageSize();
+		volatile unsigned char *pPage = (volatile unsigned char *)pDest;
+		for (size_t offset = 0; offset < n; offset += pageSize)
+		{
+			pPage[offset] = 0;
+		}
+		memcpy(pDest, pSource, n);
+	}
+
+#ifdef FASTPAGEFAULT_HAS_SIMD
+	void CopyRepMovsb(void *pDest, const void *pSource, size_t n)
+	{
+#ifdef _MSC_VER
+		__movsb((unsigned char *)pDest, (const unsigned char *)pSource, n);
+#else
+		asm volatile("rep movsb" : "+D"(pDest), "+S"(pSource), "+c"(n) : : "memory");
+#endif
+	}
+
+	FASTPAGEFAULT_TARGET("avx2") void CopyAvx2(void *pDest, const void *pSource, size_t n)
+	{
+		__m256i *d = (__m256i *)pDest;
+		const __m256i *s = (const __m256i *)pSource;
+		size_t blocks = n / BlockBytes;
+		for (size_t i = 0; i < blocks; i++, d += 8, s += 8)
+		{
+			__m256i r0 = _mm256_load_si256(s), r1 = _mm256_load_si256(s + 1), r2 = _mm256_load_si256(s + 2), r3 = _mm256_load_si256(s + 3);
+			__m256i r4 = _mm256_load_si256(s + 4), r5 = _mm256_load_si256(s + 5), r6 = _mm256_load_si256(s + 6), r7 = _mm256_load_si256(s + 7);
+			_mm256_store_si256(d, r0); _mm256_store_si256(d + 1, r1); _mm256_store_si256(d + 2, r2); _mm256_store_si256(d + 3, r3);
+			_mm256_store_si256(d + 4, r4); _mm256_store_si256(d + 5, r5); _mm256_store_si256(d + 6, r6); _mm256_store_si256(d + 7, r7);
+		}
+		memcpy(d, s, n % BlockBytes);
+	}
+
+	FASTPAGEFAULT_TARGET("avx512f") void CopyAvx512(void *pDest, const void *pSource, size_t n)
+	{
+		__m512i *d = (__m512i *)pDest;
+		const __m512i *s = (const __m512i *)pSource;
+		size_t blocks = n / BlockBytes;
+		for (size_t i = 0; i < blocks; i++, d += 4, s += 4)
+		{
+			__m512i r0 = _mm512_load_si512(s), r1 = _mm512_load_si512(s + 1), r2 = _mm512_load_si512(s + 2), r3 = _mm512_load_si512(s + 3);
+			_mm512_store_si512(d, r0); _mm512_store_si512(d + 1, r1); _mm512_store_si512(d + 2, r2); _mm512_store_si512(d + 3, r3);
+		}
+		memcpy(d, s, n % BlockBytes);
+	}
+
+	// Streaming stores bypass the caches and avoid reading the destination line before it is written (read for ownership).
+	// The sfence orders them before any later store so the copy is complete when the function returns.
+	void CopyNonTemporalSse2(void *pDest, const void *pSource, size_t n)
+	{
+		__m128i *d = (__m128i *)pDest;
+		const __m128i *s = (const __m128i *)pSource;
+		size_t blocks = n / BlockBytes;
+		for (size_t i = 0; i < blocks; i++)
+		{
+			for (int j = 0; j < 16; j++, d++, s++)
+			{
+				_mm_stream_si128(d, _mm_load_si128(s));
+			}
+		}
+		_mm_sfence();
+		memcpy(d, s, n % BlockBytes);
+	}
+
+	FASTPAGEFAULT_TARGET("avx2") void CopyNonTemporalAvx2(void *pDest, const void *pSource, size_t n)
+	{
+		__m256i *d = (__m256i *)pDest;
+		const __m256i *s = (const __m256i *)pSource;
+		size_t blocks = n / BlockBytes;
+		for (size_t i = 0; i < blocks; i++)
+		{
+			for (int j = 0; j < 8; j++, d++, s++)
+			{
+				_mm256_stream_si256(d, _mm256_load_si256(s));
+			}
+		}
+		_mm_sfence();
+		memcpy(d, s, n % BlockBytes);
+	}
+
+	FASTPAGEFAULT_TARGET("avx512f") void CopyNonTemporalAvx512(void *pDest, const void *pSource, size_t n)
+	{
+		__m512i *d = (__m512i *)pDest;
+		const __m512i *s = (const __m512i *)pSource;
+		size_t blocks = n / BlockBytes;
+		for (size_t i = 0; i < blocks; i++)
+		{
+			for (int j = 0; j < 4; j++, d++, s++)
+			{
+				_mm512_stream_si512(d, _mm512_load_si512(s));
+			}
+		}
+		_mm_sfence();
+		memcpy(d, s, n % BlockBytes);
+	}
+#endif
+}
+
+bool CopyKernel::Parse(const std::wstring &str, Kind &kind)
+{
+	if (str == L"memcpy") { kind = Kind::Memcpy; }
+	else if (str == L"movsb") { kind = Kind::RepMovsb; }
+	else if (str == L"avx2") { kind = Kind::Avx2; }
+	else if (str == L"avx512") { kind = Kind::Avx512; }
+	else if (str == L"nt") { kind = Kind::NonTemporal; }
+	else if (str == L"prefault") { kind = Kind::Prefault; }
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+const wchar_t *CopyKernel::ToString(Kind kind)
+{
+	switch (kind)
+	{
+	case Kind::Memcpy: return L"memcpy";
+	case Kind::RepMovsb: return L"movsb";
+	case Kind::Avx2: return L"avx2";
+	case Kind::Avx512: return L"avx512";
+	case Kind::NonTemporal: return L"nt";
+	case Kind::Prefault: return L"prefault";
+	}
+	return L"unknown";
+}
+
+bool CopyKernel::IsSupported(Kind kind)
+{
+	switch (kind)
+	{
+	case Kind::Memcpy:
+	case Kind::Prefault:
+		return true;
+#ifdef FASTPAGEFAULT_HAS_SIMD
+	case Kind::RepMovsb:
+	case Kind::NonTemporal:
+		return true;   // SSE2 is part of x64
+	case Kind::Avx2:
+		return HasAvx2();
+	case Kind::Avx512:
+		return HasAvx512();
+#endif
+	default:
+		return false;
+	}
+}
+
+CopyKernel::CopyFunction CopyKernel::Get(Kind kind)
+{
+	switch (kind)
+	{
+#ifdef FASTPAGEFAULT_HAS_SIMD
+	case Kind::RepMovsb:
+		return CopyRepMovsb;
+	case Kind::Avx2:
+		return CopyAvx2;
+	case Kind::Avx512:
+		return CopyAvx512;
+	case Kind::NonTemporal:
+		return HasAvx512() ? CopyNonTemporalAvx512 : HasAvx2() ? CopyNonTemporalAvx2 : CopyNonTemporalSse2;
+#endif
+	case Kind::Prefault:
+		return CopyPrefault;
+	default:
+		return CopyMemcpy;
+	}
+}
+
+// The CPU must support the instructions and the OS must save the wider registers on a context switch (XCR0)
+bool CopyKernel::HasAvx2()
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	int regs[4];
+	__cpuid(regs, 1);
+	bool bOsSaves = (regs[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+	__cpuidex(regs, 7, 0);
+	return bOsSaves && (regs[1] & (1 << 5)) != 0;
+#elif defined(FASTPAGEFAULT_HAS_SIMD)
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+bool CopyKernel::HasAvx512()
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	int regs[4];
+	__cpuid(regs, 1);
+	bool bOsSaves = (regs[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0xe6) == 0xe6;
+	__cpuidex(regs, 7, 0);
+	return bOsSaves && (regs[1] & (1 << 16)) != 0;
+#elif defined(FASTPAGEFAULT_HAS_SIMD)
+	return __builtin_cpu_supports("avx512f");
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Copy loops for -memcopy which separate the cost of the copy from the cost of faulting the destination. The SIMD kernels are
+// compiled for their instruction set and only used when the CPU supports it at run time. Destination and source must be
+// 64 byte aligned. The last n % 256 bytes are copied with memcpy.
+class CopyKernel
+{
+public:
+	enum class Kind
+	{
+		Memcpy = 0,   // memcpy of the C runtime
+		RepMovsb,     // rep movsb which is fast on CPUs with ERMS (x64 only)
+		Avx2,         // aligned 256 bit loads and stores
+		Avx512,       // aligned 512 bit loads and stores
+		NonTemporal,  // aligned loads and streaming stores of the widest supported width followed by sfence
+		Prefault,     // write one byte of every destination page, then memcpy
+	};
+
+	typedef void (*CopyFunction)(void *pDest, const void *pSource, size_t n);
+
+	// Parse memcpy, movsb, avx2, avx512, nt or prefault
+	static bool Parse(const std::wstring &str, Kind &kind);
+	static const wchar_t *ToString(Kind kind);
+	static bool IsSupported(Kind kind);
+	// Copy function of kind for this CPU. Must only be called for supported kinds.
+	static CopyFunction Get(Kind kind);
+
+private:
+	static bool HasAvx2();
+	static bool HasAvx512();
+};
@@ -2,8 +2,8 @@
 //
 
 #include "stdafx.h"
-#include <windows.h>
 #include <chrono>
+#include <clocale>
 #include <thread>
 #include <vector>
 #include <string>
@@ -16,22 +16,17 @@ using namespace FastPageFault;
 using namespace std::chrono_literals;
 
 
-int wmain(int argc, wchar_t **argv)
+static int Run(std::queue<std::wstring> &&args)
 {
-	std::queue<std::wstring> args;
-	for (int i = 1; i < argc; i++)
-	{
-		args.push(argv[i]);
-	}
-
+	int lret = 0;
 	Program p(std::move(args));
 	if (p.Parse())
 	{
-		p.Execute();
+		lret = p.Execute();
 		if (p.ShouldWait())
 		{
-			printf("\nPress any key to exit");
-			int c = getchar();
+			wprintf(L"\nPress any key to exit");
+			(void)getchar();
 		}
 	}
 	else
@@ -39,6 +34,32 @@ int wmain(int argc, wchar_t **argv)
 		p.Help();
 	}
 
-	return 0;;
+	return lret;
+}
+
+#ifdef _WIN32
+int wmain(int argc, wchar_t **argv)
+{
+	std::queue<std::wstring> args;
+	for (int i = 1; i < argc; i++)
+	{
+		args.push(argv[i]);
+	}
+
+	return Run(std::move(args));
+}
+#else
+int main(int argc, char **argv)
+{
+	setlocale(LC_ALL, ""); // needed to convert file names between wide and multibyte strings
+
+	std::queue<std::wstring> args;
+	for (int i = 1; i < argc; i++)
+	{
+		args.push(StringExtensions::ToWide(argv[i]));
+	}
+
+	return Run(std::move(args));
 }
+#endif
 #pragma optimize( "", on )
@@ -1,23 +1,21 @@
 #pragma once
 #include <string>
-#include <windows.h>
+#include <stdexcept>
+#include "Platform.h"
 
 struct FileExtensions
 {
 	static bool FileExists(std::wstring &szPath)
 	{
-		DWORD dwAttrib = GetFileAttributes(szPath.c_str());
-
-		return (dwAttrib != INVALID_FILE_ATTRIBUTES &&
-			!(dwAttrib & FILE_ATTRIBUTE_DIRECTORY));
+		return Platform::FileExists(szPath);
 	}
 
-	static HANDLE CreateWriteableFile(std::wstring &szPath)
+	static Platform::FileHandle CreateWriteableFile(std::wstring &szPath)
 	{
-		HANDLE hFile = ::CreateFile(szPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_FLAG_RANDOM_ACCESS, nullptr);
-		if (hFile == INVALID_HANDLE_VALUE)
+		Platform::FileHandle hFile = Platform::CreateWriteableFile(szPath);
+		if (hFile == Platform::InvalidFile)
 		{
-			throw std::exception("Could not open file");
+			throw std::runtime_error("Could not open file");
 		}
 
 		return hFile;
@@ -27,4 +25,3 @@ private:
 	FileExtensions();
 	~FileExtensions();
 };
-
@@ -0,0 +1,405 @@
+#include "stdafx.h"
+#include "FileIngest.h"
+#include "WorkerPool.h"
+#include <atomic>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Wall clock and process CPU time of the measured part of a load
+class FileIngest::Measurement
+{
+public:
+	void Start()
+	{
+		Platform::GetCpuTimes(_User, _System);
+		_Watch.Start();
+	}
+
+	void Stop(Result &result)
+	{
+		result.Time = _Watch.Stop();
+		std::chrono::nanoseconds user(0), system(0);
+		Platform::GetCpuTimes(user, system);
+		result.UserTime = user - _User;
+		result.SystemTime = system - _System;
+	}
+
+private:
+	Stopwatch _Watch;
+	std::chrono::nanoseconds _User{ 0 };
+	std::chrono::nanoseconds _System{ 0 };
+};
+
+bool FileIngest::Parse(const std::wstring &str, Method &method)
+{
+	if (str == L"mmap") { method = Method::Mmap; }
+	else if (str == L"read") { method = Method::Read; }
+	else if (str == L"pread") { method = Method::Pread; }
+	else if (str == L"direct") { method = Method::Direct; }
+	else if (str == L"uring") { method = Method::IoUring; }
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+const wchar_t *FileIngest::ToString(Method method)
+{
+	switch (method)
+	{
+	case Method::Mmap: return L"mmap";
+	case Method::Read: return L"read";
+	case Method::Pread: return L"pread";
+	case Method::Direct: return L"direct";
+	case Method::IoUring: return L"uring";
+	}
+	return L"";
+}
+
+bool FileIngest::IsSupported(Method method)
+{
+#ifdef _WIN32
+	return method != Method::IoUring;
+#else
+	(void)method;
+	return true;
+#endif
+}
+
+FileIngest::Result FileIngest::Load(const std::wstring &file, Method method, const Options &options)
+{
+	Result lret;
+	Measurement measurement;
+	switch (method)
+	{
+	case Method::Mmap:
+		lret.Error = LoadMapped(file, measurement, lret);
+		break;
+	case Method::Read:
+		lret.Error = LoadRead(file, false, options.BufferBytes, measurement, lret);
+		break;
+	case Method::Pread:
+		lret.Error = LoadPread(file, options.BufferBytes, options.Threads, measurement, lret);
+		break;
+	case Method::Direct:
+		lret.Error = LoadRead(file, true, options.BufferBytes, measurement, lret);
+		break;
+	case Method::IoUring:
+		lret.Error = LoadIoUring(file, options.BufferBytes, options.QueueDepth, measurement, lret);
+		break;
+	}
+	return lret;
+}
+
+// Map, fault in and unmap the file
+int FileIngest::LoadMapped(const std::wstring &file, Measurement &measurement, Result &result)
+{
+	measurement.Start();
+	try
+	{
+		MemoryMappedFile mem(file);
+		Stopwatch touch;
+		mem.TouchPages(touch);
+		result.Bytes = mem.GetFileSize();
+	}
+	catch (const std::runtime_error &)
+	{
+		return Platform::GetLastError();
+	}
+	measurement.Stop(result);
+	return 0;
+}
+
+// Sequential reads into one buffer. Unbuffered reads need a page aligned buffer and size which Platform::Allocate delivers.
+int FileIngest::LoadRead(const std::wstring &file, bool bUnbuffered, size_t bufferBytes, Measurement &measurement, Result &result)
+{
+	const size_t pageSize = Platform::GetPageSize();
+	bufferBytes = (bufferBytes + pageSize - 1) / pageSize * pageSize;
+
+	Platform::FileHandle hFile = Platform::OpenFileForSequentialRead(file, bUnbuffered);
+	if (hFile == Platform::InvalidFile)
+	{
+		return Platform::GetLastError();
+	}
+	void *pBuffer = Platform::Allocate(bufferBytes);
+	if (pBuffer == nullptr)
+	{
+		int error = Platform::GetLastError();
+		Platform::CloseFile(hFile);
+		return error;
+	}
+
+	int lret = 0;
+	measurement.Start();
+	while (true)
+	{
+		size_t read = 0;
+		if (!Platform::ReadFile(hFile, pBuffer, bufferBytes, read))
+		{
+			lret = Platform::GetLastError();
+			break;
+		}
+		if (read == 0)
+		{
+			break;
+		}
+		result.Bytes += read;
+	}
+	measurement.Stop(result);
+
+	Platform::Free(pBuffer, bufferBytes);
+	Platform::CloseFile(hFile);
+	return lret;
+}
+
+// Every thread reads its contiguous part of the file with pread into its own buffer. The threads share one file handle.
+int FileIngest::LoadPread(const std::wstring &file, size_t bufferBytes, int threads, Measurement &measurement, Result &result)
+{
+	Platform::FileHandle hFile = Platform::OpenFileForSequentialRead(file, false);
+	size_t fileSize = 0;
+	if (hFile == Platform::InvalidFile || !Platform::GetFileSize(hFile, fileSize))
+	{
+		int error = Platform::GetLastError();
+		Platform::CloseFile(hFile);
+		return error;
+	}
+
+	WorkerPool pool(threads, [](int) { return 0; });
+	std::vector<std::vector<char>> buffers(threads, std::vector<char>(bufferBytes));
+	std::atomic<size_t> bytes(0);
+	std::atomic<int> error(0);
+	const size_t part = (fileSize + threads - 1) / threads;
+
+	measurement.Start();
+	pool.Run(threads, [&](int i)
+	{
+		uint64_t offset = (uint64_t)part * i;
+		uint64_t end = (std::min)((uint64_t)fileSize, offset + part);
+		while (offset < end)
+		{
+			size_t read = 0;
+			if (!Platform::ReadFileAt(hFile, buffers[i].data(), (size_t)(std::min)((uint64_t)bufferBytes, end - offset), offset, read))
+			{
+				error = Platform::GetLastError();
+				break;
+			}
+			if (read == 0)
+			{
+				break;
+			}
+			offset += read;
+			bytes += read;
+		}
+	});
+	measurement.Stop(result);
+
+	result.Bytes = bytes;
+	Platform::CloseFile(hFile);
+	return error;
+}
+
+#ifdef _WIN32
+
+int FileIngest::LoadIoUring(const std::wstring &, size_t, int, Measurement &, Result &)
+{
+	return ERROR_NOT_SUPPORTED;
+}
+
+#else
+
+// Minimal io_uring without liburing: the submission and completion rings are mapped from the ring file descriptor
+// and every read is submitted and reaped with the io_uring_enter system call.
+struct IoUring
+{
+	int Fd = -1;
+	void *pSq = MAP_FAILED;
+	void *pCq = MAP_FAILED;
+	size_t SqBytes = 0;
+	size_t CqBytes = 0;
+	io_uring_sqe *pSqes = (io_uring_sqe *)MAP_FAILED;
+	size_t SqesBytes = 0;
+	unsigned *pSqHead, *pSqTail, *pSqMask, *pSqArray;
+	unsigned *pCqHead, *pCqTail, *pCqMask;
+	io_uring_cqe *pCqes;
+
+	bool Setup(unsigned entries)
+	{
+		io_uring_params params = {};
+		Fd = (int)::syscall(__NR_io_uring_setup, entries, &params);
+		if (Fd < 0)
+		{
+			return false;
+		}
+
+		SqBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		CqBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		bool bSingleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (bSingleMap)
+		{
+			SqBytes = CqBytes = (std::max)(SqBytes, CqBytes);
+		}
+
+		pSq = ::mmap(nullptr, SqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_SQ_RING);
+		pCq = bSingleMap ? pSq : ::mmap(nullptr, CqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_CQ_RING);
+		SqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+		pSqes = (io_uring_sqe *)::mmap(nullptr, SqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_SQES);
+		if (pSq == MAP_FAILED || pCq == MAP_FAILED || pSqes == MAP_FAILED)
+		{
+			return false;
+		}
+
+		char *sq = (char *)pSq, *cq = (char *)pCq;
+		pSqHead = (unsigned *)(sq + params.sq_off.head);
+		pSqTail = (unsigned *)(sq + params.sq_off.tail);
+		pSqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+		pSqArray = (unsigned *)(sq + params.sq_off.array);
+		pCqHead = (unsigned *)(cq + params.cq_off.head);
+		pCqTail = (unsigned *)(cq + params.cq_off.tail);
+		pCqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+		pCqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+		return true;
+	}
+
+	~IoUring()
+	{
+		if (pSqes != MAP_FAILED) { ::munmap(pSqes, SqesBytes); }
+		if (pCq != MAP_FAILED && pCq != pSq) { ::munmap(pCq, CqBytes); }
+		if (pSq != MAP_FAILED) { ::munmap(pSq, SqBytes); }
+		if (Fd >= 0) { ::close(Fd); }
+	}
+
+	// Queue a read. The ring has as many entries as reads are in flight which is why there is always a free entry.
+	void QueueRead(int fd, void *p, unsigned n, uint64_t offset, uint64_t userData)
+	{
+		unsigned tail = *pSqTail;
+		unsigned index = tail & *pSqMask;
+		io_uring_sqe &sqe = pSqes[index];
+		memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = IORING_OP_READ;
+		sqe.fd = fd;
+		sqe.addr = (uint64_t)p;
+		sqe.len = n;
+		sqe.off = offset;
+		sqe.user_data = userData;
+		pSqArray[index] = index;
+		__atomic_store_n(pSqTail, tail + 1, __ATOMIC_RELEASE);
+	}
+
+	// Submit the queued reads and wait for at least one completion
+	bool Enter(unsigned toSubmit)
+	{
+		int lret;
+		do
+		{
+			lret = (int)::syscall(__NR_io_uring_enter, Fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+		} while (lret < 0 && errno == EINTR);
+		return lret >= 0;
+	}
+};
+
+// queueDepth reads of bufferBytes are kept in flight. Every completed read submits the next part of the file into the same buffer.
+// The remainder of a short read is queued again. A read which returns 0 bytes before the expected file size fails the load with EIO.
+int FileIngest::LoadIoUring(const std::wstring &file, size_t bufferBytes, int queueDepth, Measurement &measurement, Result &result)
+{
+	Platform::FileHandle hFile = Platform::OpenFileForSequentialRead(file, false);
+	size_t fileSize = 0;
+	IoUring ring;
+	if (hFile == Platform::InvalidFile || !Platform::GetFileSize(hFile, fileSize) || !ring.Setup(queueDepth))
+	{
+		int error = Platform::GetLastError();
+		Platform::CloseFile(hFile);
+		return error;
+	}
+
+	struct Read
+	{
+		uint64_t Offset;
+		size_t Length;
+	};
+	std::vector<std::vector<char>> buffers(queueDepth, std::vector<char>(bufferBytes));
+	std::vector<Read> reads(queueDepth);
+	uint64_t nextOffset = 0;
+	int inFlight = 0;
+	int lret = 0;
+
+	measurement.Start();
+	unsigned toSubmit = 0;
+	for (int slot = 0; slot < queueDepth && nextOffset < fileSize; slot++)
+	{
+		reads[slot].Offset = nextOffset;
+		reads[slot].Length = (size_t)(std::min)((uint64_t)bufferBytes, fileSize - nextOffset);
+		ring.QueueRead(hFile, buffers[slot].data(), (unsigned)reads[slot].Length, reads[slot].Offset, slot);
+		nextOffset += reads[slot].Length;
+		toSubmit++;
+		inFlight++;
+	}
+
+	while (inFlight > 0)
+	{
+		if (!ring.Enter(toSubmit))
+		{
+			lret = errno;
+			break;
+		}
+		toSubmit = 0;
+
+		unsigned head = *ring.pCqHead;
+		unsigned tail = __atomic_load_n(ring.pCqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++)
+		{
+			const io_uring_cqe &cqe = ring.pCqes[head & *ring.pCqMask];
+			int slot = (int)cqe.user_data;
+			inFlight--;
+			if (cqe.res < 0)
+			{
+				lret = -cqe.res;
+				continue;
+			}
+			if (cqe.res == 0)
+			{
+				// end of file before the size which was read at the start: the file was truncated while it was loaded
+				lret = lret == 0 ? EIO : lret;
+				continue;
+			}
+
+			result.Bytes += cqe.res;
+			Read &read = reads[slot];
+			if ((size_t)cqe.res < read.Length)
+			{
+				// short read: read the rest of this part again
+				read.Offset += cqe.res;
+				read.Length -= cqe.res;
+			}
+			else if (nextOffset < fileSize && lret == 0)
+			{
+				read.Offset = nextOffset;
+				read.Length = (size_t)(std::min)((uint64_t)bufferBytes, fileSize - nextOffset);
+				nextOffset += read.Length;
+			}
+			else
+			{
+				continue;
+			}
+
+			ring.QueueRead(hFile, buffers[slot].data(), (unsigned)read.Length, read.Offset, slot);
+			toSubmit++;
+			inFlight++;
+		}
+		__atomic_store_n(ring.pCqHead, head, __ATOMIC_RELEASE);
+	}
+	measurement.Stop(result);
+
+	Platform::CloseFile(hFile);
+	return lret;
+}
+
+#endif
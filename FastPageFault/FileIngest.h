@@ -0,0 +1,50 @@
+#pragma once
+#include <chrono>
+#include <string>
+
+// Load a whole file into memory with different I/O methods to decide whether a data file should be mapped or read into
+// a buffer. The CPU time is the user and kernel time of the whole process while the file is loaded.
+class FileIngest
+{
+public:
+	enum class Method
+	{
+		Mmap = 0,     // map the file and read the first byte of every page
+		Read,         // buffered read into one buffer
+		Pread,        // every thread preads its contiguous part of the file into its own buffer
+		Direct,       // read with O_DIRECT / FILE_FLAG_NO_BUFFERING into a page aligned buffer
+		IoUring,      // io_uring with QueueDepth buffered reads in flight, Linux only
+	};
+
+	struct Options
+	{
+		size_t BufferBytes = 1024 * 1024;
+		int Threads = 1;           // Pread only
+		int QueueDepth = 32;       // IoUring only
+	};
+
+	struct Result
+	{
+		size_t Bytes = 0;
+		std::chrono::nanoseconds Time{ 0 };
+		std::chrono::nanoseconds UserTime{ 0 };
+		std::chrono::nanoseconds SystemTime{ 0 };
+		int Error = 0;             // Platform::GetLastError of the first failed call
+	};
+
+	// Parse mmap, read, pread, direct or uring
+	static bool Parse(const std::wstring &str, Method &method);
+	static const wchar_t *ToString(Method method);
+	static bool IsSupported(Method method);
+
+	static Result Load(const std::wstring &file, Method method, const Options &options);
+
+private:
+	class Measurement;
+
+	// Every method opens the file, starts the measurement after its setup and returns 0 or the error code
+	static int LoadMapped(const std::wstring &file, Measurement &measurement, Result &result);
+	static int LoadRead(const std::wstring &file, bool bUnbuffered, size_t bufferBytes, Measurement &measurement, Result &result);
+	static int LoadPread(const std::wstring &file, size_t bufferBytes, int threads, Measurement &measurement, Result &result);
+	static int LoadIoUring(const std::wstring &file, size_t bufferBytes, int queueDepth, Measurement &measurement, Result &result);
+};
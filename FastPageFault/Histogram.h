@@ -0,0 +1,128 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Log-linear histogram to record page fault latencies with a bounded relative error.
+// Values below 32 are stored exactly. Larger values are stored in power of two buckets which are
+// split into 16 linear sub buckets which results in a worst case error of 1/16 (6%).
+// Each thread records into its own instance without any synchronization. The per thread
+// histograms are merged after the threads were joined.
+class Histogram
+{
+public:
+	Histogram()
+	{
+		_Counts.fill(0);
+	}
+
+	void Record(uint64_t value)
+	{
+		_Counts[GetIndex(value)]++;
+		_Count++;
+		if (value > _Max)
+		{
+			_Max = value;
+		}
+	}
+
+	void Merge(const Histogram &other)
+	{
+		for (size_t i = 0; i < _Counts.size(); i++)
+		{
+			_Counts[i] += other._Counts[i];
+		}
+		_Count += other._Count;
+		if (other._Max > _Max)
+		{
+			_Max = other._Max;
+		}
+	}
+
+	uint64_t GetCount() const { return _Count; }
+	uint64_t GetMax() const { return _Max; }
+
+	// Returns the upper bound of the bucket which contains the given percentile (0-100)
+	uint64_t GetValueAtPercentile(double percentile) const
+	{
+		if (_Count == 0)
+		{
+			return 0;
+		}
+
+		uint64_t wanted = (uint64_t)(percentile / 100.0 * _Count + 0.5);
+		if (wanted == 0)
+		{
+			wanted = 1;
+		}
+
+		uint64_t sum = 0;
+		for (size_t i = 0; i < _Counts.size(); i++)
+		{
+			sum += _Counts[i];
+			if (sum >= wanted)
+			{
+				uint64_t upper = GetUpperBound(i);
+				return upper < _Max ? upper : _Max;
+			}
+		}
+		return _Max;
+	}
+
+private:
+	static const int LinearBits = 5;                        // values < 32 are exact
+	static const int SubBuckets = 1 << (LinearBits - 1);    // 16 sub buckets per power of two
+	static const size_t BucketCount = (1 << LinearBits) + (64 - LinearBits) * SubBuckets;
+
+	static int MostSignificantBit(uint64_t value)
+	{
+#if defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return (int)index;
+#elif defined(__GNUC__) || defined(__clang__)
+		return 63 - __builtin_clzll(value);
+#else
+		int msb = 0;
+		while (value >>= 1)
+		{
+			msb++;
+		}
+		return msb;
+#endif
+	}
+
+	static size_t GetIndex(uint64_t value)
+	{
+		if (value < (1 << LinearBits))
+		{
+			return (size_t)value;
+		}
+
+		int msb = MostSignificantBit(value);
+		int shift = msb - (LinearBits - 1);
+		size_t subBucket = (size_t)(value >> shift) - SubBuckets;
+		return (1 << LinearBits) + (msb - LinearBits) * SubBuckets + subBucket;
+	}
+
+	static uint64_t GetUpperBound(size_t index)
+	{
+		if (index < (1 << LinearBits))
+		{
+			return index;
+		}
+
+		size_t k = index - (1 << LinearBits);
+		int msb = (int)(k / SubBuckets) + LinearBits;
+		uint64_t top = (k % SubBuckets) + SubBuckets;
+		int shift = msb - (LinearBits - 1);
+		return ((top + 1) << shift) - 1;
+	}
+
+	std::array<uint64_t, BucketCount> _Counts;
+	uint64_t _Count = 0;
+	uint64_t _Max = 0;
+};
@@ -0,0 +1,225 @@
+#include "stdafx.h"
+#include "Interference.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static const size_t ChurnBytes = 1024 * 1024;
+static const size_t CompactionBytes = 16 * 1024 * 1024;
+
+bool Interference::Parse(const std::wstring &str, Activity &activity)
+{
+	std::wstring kind = str.substr(0, str.find(L':'));
+	if (kind == L"mmap") { activity.Type = Kind::MapChurn; }
+	else if (kind == L"mprotect") { activity.Type = Kind::Protect; }
+	else if (kind == L"alloc") { activity.Type = Kind::AllocChurn; }
+	else if (kind == L"fork") { activity.Type = Kind::Fork; }
+	else if (kind == L"thp") { activity.Type = Kind::Compaction; }
+	else
+	{
+		return false;
+	}
+
+	size_t pos = str.find(L':');
+	if (pos != std::wstring::npos)
+	{
+		wchar_t *pEnd = nullptr;
+		activity.Threads = (int)wcstol(str.c_str() + pos + 1, &pEnd, 10);
+		if (*pEnd == L':')
+		{
+			activity.Rate = (int)wcstol(pEnd + 1, nullptr, 10);
+		}
+	}
+	return activity.Threads > 0 && activity.Rate >= 0;
+}
+
+std::wstring Interference::ToString(const Activity &activity)
+{
+	const wchar_t *name = L"";
+	switch (activity.Type)
+	{
+	case Kind::FileMap: name = L"filemap"; break;
+	case Kind::MapChurn: name = L"mmap"; break;
+	case Kind::Protect: name = L"mprotect"; break;
+	case Kind::AllocChurn: name = L"alloc"; break;
+	case Kind::Fork: name = L"fork"; break;
+	case Kind::Compaction: name = L"thp"; break;
+	}
+	return StringExtensions::Format(L"%ls:%d:%d", name, activity.Threads, activity.Rate);
+}
+
+bool Interference::IsSupported(Kind kind)
+{
+#ifdef _WIN32
+	return kind != Kind::Fork && kind != Kind::Compaction;
+#else
+	(void)kind;
+	return true;
+#endif
+}
+
+Interference::~Interference()
+{
+	Stop();
+}
+
+void Interference::Start(const std::vector<Activity> &activities)
+{
+	Stop();
+	_bStop = false;
+	_Operations.clear();
+	_ActivityErrors.clear();
+	_CachedMaps.clear();
+	_StartTime = std::chrono::steady_clock::now();
+
+	for (auto &activity : activities)
+	{
+		_Operations.push_back(std::unique_ptr<std::atomic<uint64_t>>(new std::atomic<uint64_t>(0)));
+		_ActivityErrors.push_back(std::unique_ptr<std::atomic<uint64_t>>(new std::atomic<uint64_t>(0)));
+		_CachedMaps.push_back(std::unique_ptr<std::atomic<uint64_t>>(new std::atomic<uint64_t>(0)));
+		std::atomic<uint64_t> &operations = *_Operations.back();
+		std::atomic<uint64_t> &errors = *_ActivityErrors.back();
+		std::atomic<uint64_t> &cachedMaps = *_CachedMaps.back();
+		for (int i = 0; i < activity.Threads; i++)
+		{
+			_Threads.push_back(std::thread([this, activity, &operations, &errors, &cachedMaps]() { Run(activity, operations, errors, cachedMaps); }));
+		}
+	}
+}
+
+void Interference::Stop()
+{
+	if (_Threads.empty())
+	{
+		return;
+	}
+
+	_bStop = true;
+	for (auto &t : _Threads)
+	{
+		t.join();
+	}
+	_Threads.clear();
+	_RunTime = std::chrono::steady_clock::now() - _StartTime;
+}
+
+// Write the first byte of every page so that every page is faulted in
+static void TouchWrite(void *p, size_t n)
+{
+	AccessPattern::TouchWrite(p, n, Platform::GetPageSize());
+}
+
+void Interference::Run(const Activity &activity, std::atomic<uint64_t> &operations, std::atomic<uint64_t> &errors, std::atomic<uint64_t> &cachedMaps)
+{
+	void *pProtected = nullptr;
+	if (activity.Type == Kind::Protect)
+	{
+		pProtected = Platform::Allocate(ChurnBytes);
+		if (pProtected == nullptr)
+		{
+			return;
+		}
+		TouchWrite(pProtected, ChurnBytes);
+	}
+
+	uint32_t random = 0x12345678;
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t op = 0; !_bStop; op++)
+	{
+		switch (activity.Type)
+		{
+		case Kind::FileMap:
+			// An exception must not leave the thread. The failed operation is counted and retried after a short back off
+			// so that the load stays up for the whole measurement.
+			try
+			{
+				MemoryMappedFile file(activity.File, activity.bFlush);
+				if (file.GetFlushResidentFraction() != 0)
+				{
+					cachedMaps++;
+				}
+				file.TouchPages();
+			}
+			catch (const std::exception &)
+			{
+				errors++;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+			break;
+		case Kind::MapChurn:
+		{
+			void *p = Platform::Allocate(ChurnBytes);
+			if (p != nullptr)
+			{
+				TouchWrite(p, ChurnBytes);
+				Platform::Free(p, ChurnBytes);
+			}
+			break;
+		}
+		case Kind::Protect:
+			Platform::Protect(pProtected, ChurnBytes, false);
+			Platform::Protect(pProtected, ChurnBytes, true);
+			break;
+		case Kind::AllocChurn:
+		{
+			random = random * 1664525 + 1013904223; // LCG is good enough to vary the block sizes
+			size_t n = 16 * 1024 + (random >> 8) % (ChurnBytes - 16 * 1024);
+			void *p = malloc(n);
+			if (p != nullptr)
+			{
+				TouchWrite(p, n);
+				free(p);
+			}
+			break;
+		}
+		case Kind::Fork:
+		{
+#ifndef _WIN32
+			pid_t pid = ::fork();
+			if (pid == 0)
+			{
+				::_exit(0);
+			}
+			if (pid > 0)
+			{
+				::waitpid(pid, nullptr, 0);
+			}
+#endif
+			break;
+		}
+		case Kind::Compaction:
+		{
+			void *p = Platform::Allocate(CompactionBytes, Platform::PageSize::Transparent);
+			if (p != nullptr)
+			{
+				TouchWrite(p, CompactionBytes);
+				Platform::Free(p, CompactionBytes);
+			}
+			break;
+		}
+		}
+		operations++;
+
+		// sleep in small steps to react quickly to Stop also at low rates
+		auto next = start + std::chrono::microseconds(activity.Rate > 0 ? (op + 1) * 1000000 / activity.Rate : 0);
+		while (activity.Rate > 0 && !_bStop)
+		{
+			auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(next - std::chrono::steady_clock::now());
+			if (remaining.count() <= 0)
+			{
+				break;
+			}
+			std::this_thread::sleep_for((std::min)(remaining, std::chrono::microseconds(10000)));
+		}
+	}
+
+	if (pProtected != nullptr)
+	{
+		Platform::Free(pProtected, ChurnBytes);
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Background activities which run on their own threads while a scenario is measured. Most of them take the
+// address space lock of the process (mmap_lock on Linux) for writing and therefore stall the page faults of the
+// foreground threads.
+class Interference
+{
+public:
+	enum class Kind
+	{
+		FileMap = 0,   // map, touch and unmap a file (-file)
+		MapChurn,      // map, touch and unmap 1 MB of anonymous memory
+		Protect,       // toggle a 1 MB buffer between read only and read/write
+		AllocChurn,    // malloc, touch and free blocks between 16 KB and 1 MB
+		Fork,          // fork a child which exits immediately (copies the page tables of the process)
+		Compaction,    // fault and free 16 MB of transparent huge pages which needs physically contiguous memory
+	};
+
+	struct Activity
+	{
+		Kind Type = Kind::MapChurn;
+		int Threads = 1;
+		int Rate = 0;              // operations per second and thread, 0 runs as fast as possible
+		std::wstring File;         // file of FileMap
+		bool bFlush = false;       // flush the file system cache before every FileMap operation
+	};
+
+	// Parse kind[:threads[:rate]] where kind is mmap, mprotect, alloc, fork or thp
+	static bool Parse(const std::wstring &str, Activity &activity);
+	static bool IsSupported(Kind kind);
+	static std::wstring ToString(const Activity &activity);
+
+	Interference() = default;
+	~Interference();
+
+	// Start all activities on background threads. They run until Stop is called.
+	void Start(const std::vector<Activity> &activities);
+	void Stop();
+
+	// Results of the last Start/Stop cycle
+	uint64_t GetOperations(size_t activity) const { return _Operations[activity]->load(); }
+	// Number of operations of the activity which failed and were retried
+	uint64_t GetErrors(size_t activity) const { return _ActivityErrors[activity]->load(); }
+	// Number of FileMap operations which touched a file that could not be evicted from the file system cache with -flush
+	uint64_t GetCachedMaps(size_t activity) const { return _CachedMaps[activity]->load(); }
+	std::chrono::nanoseconds GetRunTime() const { return _RunTime; }
+
+private:
+	Interference(const Interference &) = delete;
+	Interference &operator=(const Interference &) = delete;
+
+	void Run(const Activity &activity, std::atomic<uint64_t> &operations, std::atomic<uint64_t> &errors, std::atomic<uint64_t> &cachedMaps);
+
+	std::vector<std::thread> _Threads;
+	std::vector<std::unique_ptr<std::atomic<uint64_t>>> _Operations;
+	std::vector<std::unique_ptr<std::atomic<uint64_t>>> _ActivityErrors;
+	std::vector<std::unique_ptr<std::atomic<uint64_t>>> _CachedMaps;
+	std::atomic<bool> _bStop{ false };
+	std::chrono::steady_clock::time_point _StartTime;
+	std::chrono::nanoseconds _RunTime{ 0 };
+};
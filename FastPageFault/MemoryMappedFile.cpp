@@ -1,106 +1,220 @@
 #include "stdafx.h"
 #include "MemoryMappedFile.h"
+#include <stdexcept>
+#include <chrono>
+#include "TickCounter.h"
+#include "CacheState.h"
 
 
-MemoryMappedFile::MemoryMappedFile(std::wstring &file, bool bFlushFileSystemCacheOfFile)
+MemoryMappedFile::MemoryMappedFile(const std::wstring &file, bool bFlushFileSystemCacheOfFile, bool bCopyOnWrite, Platform::MapAdvice advice)
 {
-	hFile = nullptr;
-	hFileMapping = nullptr;
+	hFile = Platform::InvalidFile;
+	hFileMapping = 0;
 	pFile = nullptr;
+	fileSize = 0;
+	readAhead = 0;
+	adviceError = 0;
+	flushResident = 0;
+	mapTime = std::chrono::nanoseconds(0);
+	prefetchTime = std::chrono::nanoseconds(0);
 
 	if (bFlushFileSystemCacheOfFile)
 	{
 		FlushFSCache(file);
 	}
 
-	hFile = ::CreateFile(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
-	if (hFile == INVALID_HANDLE_VALUE)
+	hFile = Platform::OpenFileForRead(file);
+	if (hFile == Platform::InvalidFile)
 	{
-		throw std::exception("Could not open file");
+		throw std::runtime_error("Could not open file");
 	}
 
-	hFileMapping = ::CreateFileMapping(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
-	if (hFileMapping == NULL)
+	if (!Platform::GetFileSize(hFile, fileSize))
 	{
-		throw std::exception("Could not create file mapping");
+		Platform::CloseFile(hFile);
+		throw std::runtime_error("Could not get file information");
 	}
 
-	pFile = MapViewOfFile(hFileMapping, FILE_MAP_READ, 0, 0, 0);
+	Stopwatch sw;
+	sw.Start();
+	pFile = Platform::MapFile(hFile, fileSize, hFileMapping, bCopyOnWrite, advice == Platform::MapAdvice::Populate);
+	mapTime = sw.Stop();
 	if (pFile == nullptr)
 	{
-		throw std::exception("MapViewOfFile failed");
+		Platform::UnmapFile(nullptr, 0, hFileMapping);
+		Platform::CloseFile(hFile);
+		throw std::runtime_error("Could not create file mapping");
+	}
+
+	if (advice != Platform::MapAdvice::Normal && advice != Platform::MapAdvice::WillNeed && advice != Platform::MapAdvice::Populate &&
+		!Platform::AdviseMapping(pFile, fileSize, advice))
+	{
+		adviceError = Platform::GetLastError();
 	}
 }
 
-void MemoryMappedFile::FlushFSCache(std::wstring &file)
+bool MemoryMappedFile::ParseAdvice(const std::wstring &str, Platform::MapAdvice &advice)
 {
-	HANDLE hUnbufferedHandle = ::CreateFile(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
-	if (hUnbufferedHandle == INVALID_HANDLE_VALUE)
+	if (str == L"normal") { advice = Platform::MapAdvice::Normal; }
+	else if (str == L"sequential") { advice = Platform::MapAdvice::Sequential; }
+	else if (str == L"random") { advice = Platform::MapAdvice::Random; }
+	else if (str == L"willneed") { advice = Platform::MapAdvice::WillNeed; }
+	else if (str == L"hugepage") { advice = Platform::MapAdvice::HugePage; }
+	else if (str == L"populate") { advice = Platform::MapAdvice::Populate; }
+	else
 	{
-		throw std::exception("Could not open file in unbuffered mode.");
+		return false;
 	}
-	::CloseHandle(hUnbufferedHandle);
+	return true;
 }
 
-size_t MemoryMappedFile::GetFileSize()
+const wchar_t *MemoryMappedFile::ToString(Platform::MapAdvice advice)
 {
-	BY_HANDLE_FILE_INFORMATION fileInfo;
+	switch (advice)
+	{
+	case Platform::MapAdvice::Sequential: return L"sequential";
+	case Platform::MapAdvice::Random: return L"random";
+	case Platform::MapAdvice::WillNeed: return L"willneed";
+	case Platform::MapAdvice::HugePage: return L"hugepage";
+	case Platform::MapAdvice::Populate: return L"populate";
+	default: return L"normal";
+	}
+}
+
+bool MemoryMappedFile::IsSupported(Platform::MapAdvice advice)
+{
+#ifdef _WIN32
+	return advice == Platform::MapAdvice::Normal || advice == Platform::MapAdvice::WillNeed;
+#else
+	(void)advice;
+	return true;
+#endif
+}
 
-	BOOL lGetFileRet = ::GetFileInformationByHandle(hFile, &fileInfo);
-	if (lGetFileRet == FALSE)
+// Best effort: pages of a file which is mapped by another thread or process stay resident. The residency is kept for the caller
+// which decides whether a warm mapping is acceptable.
+void MemoryMappedFile::FlushFSCache(const std::wstring &file)
+{
+	if (!CacheState::Evict(file))
 	{
-		throw std::exception("Could not get file information");
+		flushResident = CacheState::GetResidentFraction(file);
 	}
+}
 
-	size_t fileSize = 1;
-	fileSize = (((size_t)fileInfo.nFileSizeHigh) << 32) + (size_t)fileInfo.nFileSizeLow;
+size_t MemoryMappedFile::GetFileSize()
+{
 	return fileSize;
 }
 
 #pragma optimize( "", off )
-void MemoryMappedFile::TouchPages(Stopwatch &sw, bool bPrefetch, int sleepBeforeTouchMs)
+bool MemoryMappedFile::TouchPages(Stopwatch &sw, bool bPrefetch, int prefetchTimeoutMs, Histogram *pHistogram, PerfCounterValues *pCounters,
+	const AccessPattern *pPattern, PageAccess access)
 {
-	size_t fileSize = GetFileSize();
+	bool lret = !bPrefetch || Prefetch(prefetchTimeoutMs);
+
+	PerfCounterScope perf(pCounters);
+	sw.Start();
 
-	if (bPrefetch)
+	volatile unsigned char *pStart = (unsigned char *)pFile;
+	const size_t pageSize = Platform::GetPageSize();
+	if (readAhead > 0 && (pPattern == nullptr || pPattern->GetKind() == AccessPattern::Kind::Sequential))
 	{
-		WIN32_MEMORY_RANGE_ENTRY range;
-		range.NumberOfBytes = fileSize;
-		range.VirtualAddress = pFile;
+		TouchWithReadAhead(access, pHistogram);
+		return lret;
+	}
 
-		BOOL lPrefecth = ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
-		if (!lPrefecth)
+	if (pPattern != nullptr)
+	{
+		pPattern->Touch(pFile, 0, access, pHistogram);
+		return lret;
+	}
+
+	if (pHistogram != nullptr)
+	{
+		for (size_t i = 0; i < fileSize; i += pageSize)
 		{
-			wprintf(L"PrefetchVirtualMemory failed with error code: %d\n", ::GetLastError());
+			uint64_t start = TickCounter::Now();
+			(void)*(pStart + i);
+			pHistogram->Record(TickCounter::Now() - start);
 		}
-		::Sleep(2000);
+		return lret;
 	}
 
-	sw.Start();
-
-	byte *pStart = (byte *)pFile;
-	int tmp = 0;
-	for (size_t i = 0; i < fileSize; i+= 4096) // touch in 4 K blocks
+	for (size_t i = 0; i < fileSize; i += pageSize) // touch every page once
 	{
-		tmp = *(pStart + i);
+		(void)*(pStart + i);
 	}
+	return lret;
 }
-#pragma optimize( "", on )
 
-MemoryMappedFile::~MemoryMappedFile()
+// Touch the pages in windows of readAhead bytes and prefetch the next window before the current one is touched
+void MemoryMappedFile::TouchWithReadAhead(PageAccess access, Histogram *pHistogram)
 {
-	if (hFile != nullptr && hFile != INVALID_HANDLE_VALUE)
+	volatile unsigned char *pStart = (unsigned char *)pFile;
+	const size_t pageSize = Platform::GetPageSize();
+	for (size_t window = 0; window < fileSize; window += readAhead)
 	{
-		::CloseHandle(hFile);
+		size_t windowEnd = (std::min)(window + readAhead, fileSize);
+		if (windowEnd < fileSize)
+		{
+			Platform::Prefetch((unsigned char *)pFile + windowEnd, (std::min)(readAhead, fileSize - windowEnd));
+		}
+
+		for (size_t i = window; i < windowEnd; i += pageSize)
+		{
+			uint64_t start = pHistogram != nullptr ? TickCounter::Now() : 0;
+			switch (access)
+			{
+			case PageAccess::Read: (void)pStart[i]; break;
+			case PageAccess::Write: pStart[i] = 1; break;
+			case PageAccess::Rmw: pStart[i] = pStart[i] + 1; break;
+			}
+			if (pHistogram != nullptr)
+			{
+				pHistogram->Record(TickCounter::Now() - start);
+			}
+		}
 	}
+}
+#pragma optimize( "", on )
 
-	if (hFileMapping != NULL)
+// The residency of the file pages is polled. The prefetch has completed when all pages are resident or when no page was read
+// for 100 ms e.g. because the file does not fit into memory.
+bool MemoryMappedFile::Prefetch(int timeoutMs)
+{
+	const auto stallTime = std::chrono::milliseconds(100);
+	Stopwatch sw;
+	sw.Start();
+	prefetchTime = std::chrono::nanoseconds(0);
+	if (!Platform::Prefetch(pFile, fileSize))
 	{
-		::CloseHandle(hFileMapping);
+		return false;
 	}
 
-	if (pFile != NULL)
+	double lastResident = -1;
+	auto lastProgress = sw.Stop();
+	while (true)
 	{
-		::UnmapViewOfFile(pFile);
+		double resident = GetResidentFraction();
+		auto now = sw.Stop();
+		if (resident > lastResident)
+		{
+			lastResident = resident;
+			lastProgress = now;
+			prefetchTime = now;
+		}
+
+		if (resident < 0 || resident >= 1.0 || now - lastProgress > stallTime || now > std::chrono::milliseconds(timeoutMs))
+		{
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
 	}
+	return true;
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+	Platform::UnmapFile(pFile, fileSize, hFileMapping);
+	Platform::CloseFile(hFile);
 }
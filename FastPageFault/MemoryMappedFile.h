@@ -1,21 +1,69 @@
 #pragma once
-#include <windows.h>
+#include <chrono>
 #include <string>
+#include "Platform.h"
 #include "Stopwatch.h"
+#include "Histogram.h"
+#include "PerfCounters.h"
+#include "AccessPattern.h"
 
 class MemoryMappedFile
 {
 public:
-	MemoryMappedFile(std::wstring &file, bool bFlushFileSystemCacheOfFile = false);
-	void TouchPages(Stopwatch &sw, bool bPrefetch=false, int sleepBeforeTouchMs=10000);
+	// With bCopyOnWrite the file is mapped private and writeable. Writes are never written back to the file.
+	// advice is set on the mapping after it was created. WillNeed is applied by TouchPages with bPrefetch.
+	// The flush with bFlushFileSystemCacheOfFile is best effort, see GetFlushResidentFraction.
+	MemoryMappedFile(const std::wstring &file, bool bFlushFileSystemCacheOfFile = false, bool bCopyOnWrite = false,
+		Platform::MapAdvice advice = Platform::MapAdvice::Normal);
+
+	// Parse normal, sequential, random, willneed, hugepage or populate
+	static bool ParseAdvice(const std::wstring &str, Platform::MapAdvice &advice);
+	static const wchar_t *ToString(Platform::MapAdvice advice);
+	static bool IsSupported(Platform::MapAdvice advice);
+
+	// Read the next readAheadBytes with a prefetch whenever the previous window is reached while the pages are touched
+	// sequentially. 0 leaves the read ahead to the OS.
+	void SetReadAhead(size_t readAheadBytes) { readAhead = readAheadBytes; }
+
+	// Read the file asynchronously into memory and wait until the pages are resident, no more pages were read for 100 ms
+	// or timeoutMs has passed. Returns false when the prefetch could not be started. Platform::GetLastError has the reason.
+	bool Prefetch(int timeoutMs);
+
+	// Touch all pages of the file. With bPrefetch Prefetch(prefetchTimeoutMs) is called first. When pHistogram is given every page access is timed with TickCounter.
+	// When pCounters is given the perf counters of the calling thread are collected while the pages are touched.
+	// When pPattern is given the pages are accessed in the order of thread 0 of the pattern which must be prepared for GetFileSize() bytes.
+	// Write and Rmw access need a copy on write mapping. Returns false when the prefetch failed.
+	bool TouchPages(Stopwatch &sw, bool bPrefetch=false, int prefetchTimeoutMs=10000, Histogram *pHistogram=nullptr, PerfCounterValues *pCounters=nullptr,
+		const AccessPattern *pPattern=nullptr, PageAccess access=PageAccess::Read);
+	// Read all pages without measuring the time
+	void TouchPages() { Stopwatch sw; TouchPages(sw); }
 	size_t GetFileSize();
+	void *GetAddress() { return pFile; }
+	// Duration of the mmap call which includes reading the file for Populate
+	std::chrono::nanoseconds GetMapTime() const { return mapTime; }
+	// Error code of the advice which was set by the constructor, 0 if it succeeded
+	int GetAdviceError() const { return adviceError; }
+	// Fraction (0-1) of the file which stayed in the file system cache after the flush of the constructor. 0 when it was evicted
+	// or not flushed, -1 when the flush failed and the residency cannot be determined.
+	double GetFlushResidentFraction() const { return flushResident; }
+	// Time until the last page of the prefetch became resident
+	std::chrono::nanoseconds GetPrefetchTime() const { return prefetchTime; }
+	// Fraction of the file pages which are resident in the file system cache
+	double GetResidentFraction() { return Platform::GetResidentFraction(pFile, fileSize); }
 	~MemoryMappedFile();
 private:
-	void FlushFSCache(std::wstring &file);
+	void FlushFSCache(const std::wstring &file);
+	void TouchWithReadAhead(PageAccess access, Histogram *pHistogram);
 private:
-	HANDLE hFile;
-	HANDLE hFileMapping;
+	Platform::FileHandle hFile;
+	Platform::MappingHandle hFileMapping;
 	void *pFile;
+	size_t fileSize;
+	size_t readAhead;
+	int adviceError;
+	double flushResident;
+	std::chrono::nanoseconds mapTime;
+	std::chrono::nanoseconds prefetchTime;
 
 };
 
@@ -0,0 +1,523 @@
+#include "stdafx.h"
+#include "Numa.h"
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fstream>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// ===== Platform independent parts =====
+
+bool Numa::ParsePolicy(const std::wstring &str, Policy &policy, int &bindNode)
+{
+	if (str == L"firsttouch") { policy = Policy::FirstTouch; }
+	else if (str == L"local") { policy = Policy::Local; }
+	else if (str == L"interleave") { policy = Policy::Interleave; }
+	else if (str.compare(0, 5, L"bind:") == 0 && str.size() > 5)
+	{
+		policy = Policy::Bind;
+		bindNode = (int)wcstol(str.c_str() + 5, nullptr, 10);
+		return IsNode(bindNode);
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+bool Numa::ParseAffinity(const std::wstring &str, Affinity &affinity)
+{
+	if (str == L"compact") { affinity = Affinity::Compact; }
+	else if (str == L"scatter") { affinity = Affinity::Scatter; }
+	else if (str == L"pernode") { affinity = Affinity::PerNode; }
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+const wchar_t *Numa::ToString(Policy policy)
+{
+	switch (policy)
+	{
+	case Policy::FirstTouch: return L"firsttouch";
+	case Policy::Local: return L"local";
+	case Policy::Interleave: return L"interleave";
+	case Policy::Bind: return L"bind";
+	default: return L"default";
+	}
+}
+
+const wchar_t *Numa::ToString(Affinity affinity)
+{
+	switch (affinity)
+	{
+	case Affinity::Compact: return L"compact";
+	case Affinity::Scatter: return L"scatter";
+	case Affinity::PerNode: return L"pernode";
+	default: return L"none";
+	}
+}
+
+bool Numa::IsNode(int id)
+{
+	for (auto &node : GetTopology())
+	{
+		if (node.Id == id)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int Numa::GetRemoteNode(int id)
+{
+	auto &topology = GetTopology();
+	for (size_t i = 0; i < topology.size(); i++)
+	{
+		if (topology[i].Id == id)
+		{
+			return topology[(i + 1) % topology.size()].Id;
+		}
+	}
+	return id;
+}
+
+std::wstring Numa::GetNodeIds()
+{
+	std::wstring ids;
+	for (auto &node : GetTopology())
+	{
+		ids += StringExtensions::Format(L"%ls%d", ids.empty() ? L"" : L", ", node.Id);
+	}
+	return ids;
+}
+
+double Numa::GetLocalFraction(void *p, size_t n, int node, size_t maxSamples)
+{
+	const size_t pageSize = Platform::GetPageSize();
+	size_t pages = n / pageSize;
+	size_t step = pages > maxSamples ? pages / maxSamples : 1;
+
+	std::vector<void *> addresses;
+	for (size_t page = 0; page < pages; page += step)
+	{
+		addresses.push_back((char *)p + page * pageSize);
+	}
+	return GetLocalFraction(addresses, node);
+}
+
+// Select the CPUs a worker thread may run on. Returns the node id of the CPUs or -1 if no node has CPUs.
+// Nodes without CPUs (memory only or CXL nodes) are skipped.
+static int SelectCpus(Numa::Affinity affinity, int threadIndex, std::vector<int> &cpus)
+{
+	std::vector<const Numa::Node *> cpuNodes;
+	size_t total = 0;
+	for (auto &node : Numa::GetTopology())
+	{
+		if (!node.Cpus.empty())
+		{
+			cpuNodes.push_back(&node);
+			total += node.Cpus.size();
+		}
+	}
+	if (cpuNodes.empty())
+	{
+		return -1;
+	}
+	int nodes = (int)cpuNodes.size();
+
+	switch (affinity)
+	{
+	case Numa::Affinity::Compact:
+	{
+		size_t index = threadIndex % total;
+		for (auto pNode : cpuNodes)
+		{
+			if (index < pNode->Cpus.size())
+			{
+				cpus.push_back(pNode->Cpus[index]);
+				return pNode->Id;
+			}
+			index -= pNode->Cpus.size();
+		}
+		return -1;
+	}
+	case Numa::Affinity::Scatter:
+	{
+		const Numa::Node &node = *cpuNodes[threadIndex % nodes];
+		cpus.push_back(node.Cpus[(threadIndex / nodes) % node.Cpus.size()]);
+		return node.Id;
+	}
+	case Numa::Affinity::PerNode:
+	{
+		const Numa::Node &node = *cpuNodes[threadIndex % nodes];
+		cpus = node.Cpus;
+		return node.Id;
+	}
+	default:
+		return -1;
+	}
+}
+
+#ifdef _WIN32
+#include <psapi.h>
+
+// Nodes of other processor groups are kept with an empty CPU list so that the ids stay the node numbers of Windows
+const std::vector<Numa::Node> &Numa::GetTopology()
+{
+	static const std::vector<Node> topology = []()
+	{
+		std::vector<Node> nodes;
+		ULONG highestNode = 0;
+		if (::GetNumaHighestNodeNumber(&highestNode))
+		{
+			for (USHORT id = 0; id <= highestNode; id++)
+			{
+				GROUP_AFFINITY affinity;
+				if (!::GetNumaNodeProcessorMaskEx(id, &affinity))
+				{
+					continue;
+				}
+
+				Node node;
+				node.Id = id;
+				for (int cpu = 0; cpu < (int)sizeof(KAFFINITY) * 8 && affinity.Group == 0; cpu++)
+				{
+					if (affinity.Mask & ((KAFFINITY)1 << cpu))
+					{
+						node.Cpus.push_back(cpu);
+					}
+				}
+				nodes.push_back(node);
+			}
+		}
+
+		if (nodes.empty())
+		{
+			Node node;
+			for (int cpu = 0; cpu < (int)std::thread::hardware_concurrency(); cpu++)
+			{
+				node.Cpus.push_back(cpu);
+			}
+			nodes.push_back(node);
+		}
+		return nodes;
+	}();
+	return topology;
+}
+
+int Numa::GetCurrentNode()
+{
+	PROCESSOR_NUMBER processor;
+	::GetCurrentProcessorNumberEx(&processor);
+	USHORT node = 0;
+	if (!::GetNumaProcessorNodeEx(&processor, &node))
+	{
+		return 0;
+	}
+	return node;
+}
+
+// VirtualAllocExNuma can only express a preferred node. Interleaving is not supported on Windows.
+void *Numa::Allocate(size_t n, Platform::PageSize pageSize, Policy policy, int bindNode)
+{
+	if (policy == Policy::None || policy == Policy::FirstTouch || pageSize != Platform::PageSize::Default)
+	{
+		return Platform::Allocate(n, pageSize);
+	}
+
+	if (policy == Policy::Interleave)
+	{
+		::SetLastError(ERROR_NOT_SUPPORTED);
+		return nullptr;
+	}
+
+	DWORD node = policy == Policy::Local ? GetCurrentNode() : bindNode;
+	return ::VirtualAllocExNuma(::GetCurrentProcess(), NULL, n, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node);
+}
+
+// Windows has no MAP_POPULATE equivalent
+void *Numa::AllocatePopulated(size_t n, Platform::PageSize pageSize, Policy, int)
+{
+	return Platform::AllocatePopulated(n, pageSize);
+}
+
+int Numa::PinThread(Affinity affinity, int threadIndex)
+{
+	std::vector<int> cpus;
+	int node = SelectCpus(affinity, threadIndex, cpus);
+	if (node == -1)
+	{
+		return -1;
+	}
+
+	KAFFINITY mask = 0;
+	for (int cpu : cpus)
+	{
+		mask |= (KAFFINITY)1 << cpu;
+	}
+	::SetThreadAffinityMask(::GetCurrentThread(), mask);
+	return node;
+}
+
+double Numa::GetLocalFraction(const std::vector<void *> &pages, int node)
+{
+	std::vector<PSAPI_WORKING_SET_EX_INFORMATION> infos(pages.size());
+	for (size_t i = 0; i < pages.size(); i++)
+	{
+		infos[i].VirtualAddress = pages[i];
+	}
+
+	if (infos.empty() || !::QueryWorkingSetEx(::GetCurrentProcess(), infos.data(), (DWORD)(infos.size() * sizeof(infos[0]))))
+	{
+		return -1;
+	}
+
+	size_t resident = 0, local = 0;
+	for (auto &info : infos)
+	{
+		if (info.VirtualAttributes.Valid)
+		{
+			resident++;
+			local += (int)info.VirtualAttributes.Node == node ? 1 : 0;
+		}
+	}
+	return resident == 0 ? -1 : (double)local / resident;
+}
+
+#else
+
+#ifndef MPOL_DEFAULT
+#define MPOL_DEFAULT 0
+#define MPOL_PREFERRED 1
+#define MPOL_BIND 2
+#define MPOL_INTERLEAVE 3
+#define MPOL_LOCAL 4
+#endif
+
+// Parse the cpulist and nodelist format of sysfs e.g. "0-3,8-11"
+static std::vector<int> ParseList(const std::string &list)
+{
+	std::vector<int> cpus;
+	size_t pos = 0;
+	while (pos < list.size())
+	{
+		size_t end = list.find(',', pos);
+		if (end == std::string::npos)
+		{
+			end = list.size();
+		}
+		std::string range = list.substr(pos, end - pos);
+		size_t dash = range.find('-');
+		if (!range.empty() && isdigit(range[0]))
+		{
+			int first = atoi(range.c_str());
+			int last = dash == std::string::npos ? first : atoi(range.c_str() + dash + 1);
+			for (int cpu = first; cpu <= last; cpu++)
+			{
+				cpus.push_back(cpu);
+			}
+		}
+		pos = end + 1;
+	}
+	return cpus;
+}
+
+// The online node ids can have gaps e.g. after a node was offlined or with sub NUMA clustering on some sockets only
+const std::vector<Numa::Node> &Numa::GetTopology()
+{
+	static const std::vector<Node> topology = []()
+	{
+		std::vector<Node> nodes;
+		std::ifstream online("/sys/devices/system/node/online");
+		std::string ids;
+		std::getline(online, ids);
+		for (int id : ParseList(ids))
+		{
+			std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+			if (!file)
+			{
+				continue;
+			}
+			std::string list;
+			std::getline(file, list);
+			Node node;
+			node.Id = id;
+			node.Cpus = ParseList(list); // memory only nodes have an empty CPU list
+			nodes.push_back(node);
+		}
+
+		if (nodes.empty())
+		{
+			Node node;
+			for (int cpu = 0; cpu < (int)std::thread::hardware_concurrency(); cpu++)
+			{
+				node.Cpus.push_back(cpu);
+			}
+			nodes.push_back(node);
+		}
+		return nodes;
+	}();
+	return topology;
+}
+
+int Numa::GetCurrentNode()
+{
+	unsigned int cpu = 0, node = 0;
+	if (::syscall(__NR_getcpu, &cpu, &node, nullptr) != 0)
+	{
+		return 0;
+	}
+	return (int)node;
+}
+
+static const size_t BitsPerLong = sizeof(unsigned long) * 8;
+
+static std::vector<unsigned long> GetNodeMask(const std::vector<int> &nodes)
+{
+	std::vector<unsigned long> mask(1024 / BitsPerLong, 0);
+	for (int node : nodes)
+	{
+		mask[node / BitsPerLong] |= 1UL << (node % BitsPerLong);
+	}
+	return mask;
+}
+
+static bool MBind(void *p, size_t n, int mode, const std::vector<int> &nodes)
+{
+	std::vector<unsigned long> mask = GetNodeMask(nodes);
+	unsigned long *pMask = nodes.empty() ? nullptr : mask.data();
+	return ::syscall(__NR_mbind, p, n, mode, pMask, nodes.empty() ? 0 : mask.size() * BitsPerLong, 0) == 0;
+}
+
+static bool SetMemPolicy(int mode, const std::vector<int> &nodes)
+{
+	std::vector<unsigned long> mask = GetNodeMask(nodes);
+	unsigned long *pMask = nodes.empty() ? nullptr : mask.data();
+	return ::syscall(__NR_set_mempolicy, mode, pMask, nodes.empty() ? 0 : mask.size() * BitsPerLong) == 0;
+}
+
+// Kernel mode and node list of the policy
+static void GetPolicyNodes(Numa::Policy policy, int bindNode, int &mode, std::vector<int> &nodes)
+{
+	switch (policy)
+	{
+	case Numa::Policy::FirstTouch:
+		mode = MPOL_LOCAL;
+		break;
+	case Numa::Policy::Local:
+		mode = MPOL_BIND;
+		nodes.push_back(Numa::GetCurrentNode());
+		break;
+	case Numa::Policy::Interleave:
+		mode = MPOL_INTERLEAVE;
+		for (auto &node : Numa::GetTopology())
+		{
+			nodes.push_back(node.Id);
+		}
+		break;
+	case Numa::Policy::Bind:
+		mode = MPOL_BIND;
+		nodes.push_back(bindNode);
+		break;
+	default:
+		mode = MPOL_DEFAULT;
+		break;
+	}
+}
+
+void *Numa::Allocate(size_t n, Platform::PageSize pageSize, Policy policy, int bindNode)
+{
+	void *p = Platform::Allocate(n, pageSize);
+	if (p == nullptr || policy == Policy::None)
+	{
+		return p;
+	}
+
+	int mode = MPOL_DEFAULT;
+	std::vector<int> nodes;
+	GetPolicyNodes(policy, bindNode, mode, nodes);
+	bool lret = MBind(p, n, mode, nodes);
+
+	if (!lret)
+	{
+		int err = errno;
+		Platform::Free(p, n);
+		errno = err;
+		return nullptr;
+	}
+	return p;
+}
+
+void *Numa::AllocatePopulated(size_t n, Platform::PageSize pageSize, Policy policy, int bindNode)
+{
+	if (policy == Policy::None)
+	{
+		return Platform::AllocatePopulated(n, pageSize);
+	}
+
+	int mode = MPOL_DEFAULT;
+	std::vector<int> nodes;
+	GetPolicyNodes(policy, bindNode, mode, nodes);
+	if (!SetMemPolicy(mode, nodes))
+	{
+		return nullptr;
+	}
+
+	void *p = Platform::AllocatePopulated(n, pageSize);
+	int err = errno;
+	SetMemPolicy(MPOL_DEFAULT, std::vector<int>());
+	errno = err;
+	return p;
+}
+
+int Numa::PinThread(Affinity affinity, int threadIndex)
+{
+	std::vector<int> cpus;
+	int node = SelectCpus(affinity, threadIndex, cpus);
+	if (node == -1)
+	{
+		return -1;
+	}
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int cpu : cpus)
+	{
+		CPU_SET(cpu, &set);
+	}
+	::sched_setaffinity(0, sizeof(set), &set);
+	return node;
+}
+
+// move_pages without target nodes only queries the node of every page
+double Numa::GetLocalFraction(const std::vector<void *> &pages, int node)
+{
+	std::vector<int> status(pages.size(), -1);
+	std::vector<void *> addresses(pages);
+
+	if (addresses.empty() || ::syscall(__NR_move_pages, 0, addresses.size(), addresses.data(), nullptr, status.data(), 0) != 0)
+	{
+		return -1;
+	}
+
+	size_t resident = 0, local = 0;
+	for (int pageNode : status)
+	{
+		if (pageNode >= 0)
+		{
+			resident++;
+			local += pageNode == node ? 1 : 0;
+		}
+	}
+	return resident == 0 ? -1 : (double)local / resident;
+}
+
+#endif
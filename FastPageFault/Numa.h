@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Platform.h"
+
+// NUMA topology, memory placement policies and thread pinning.
+// On Linux this uses sysfs for the topology, mbind/move_pages for memory placement and sched_setaffinity for pinning.
+// On Windows GetNumaNodeProcessorMaskEx, VirtualAllocExNuma, QueryWorkingSetEx and SetThreadAffinityMask are used
+// which only cover the first processor group.
+struct Numa
+{
+	// Where the physical pages of a buffer are placed
+	enum class Policy
+	{
+		None = 0,     // OS default
+		FirstTouch,   // explicitly allocate on the node of the thread which faults the page first
+		Local,        // bind to the node of the thread which allocates the buffer
+		Interleave,   // round robin pages over all nodes
+		Bind,         // bind to a given node
+	};
+
+	// How worker threads are pinned to CPUs
+	enum class Affinity
+	{
+		None = 0,     // let the scheduler decide
+		Compact,      // fill all CPUs of node 0 first, then node 1, ...
+		Scatter,      // round robin threads over nodes, one CPU per thread
+		PerNode,      // round robin threads over nodes, each thread may run on any CPU of its node
+	};
+
+	struct Node
+	{
+		int Id = 0;              // node number of the OS which is used by the memory policies and reported by GetCurrentNode
+		std::vector<int> Cpus;   // empty for memory only nodes
+	};
+
+	// All online nodes ordered by their id. The ids can have gaps. A machine without NUMA support has one node 0 with all CPUs.
+	static const std::vector<Node> &GetTopology();
+	static int GetNodeCount() { return (int)GetTopology().size(); }
+	static bool IsNode(int id);
+	// Next node after id in the topology which wraps around to the first node. Returns id on a machine with one node.
+	static int GetRemoteNode(int id);
+	// Node ids for messages e.g. "0, 1, 3"
+	static std::wstring GetNodeIds();
+	// Node of the CPU the calling thread currently runs on
+	static int GetCurrentNode();
+
+	// Allocate memory with the given page size and placement policy. Free it with Platform::Free.
+	static void *Allocate(size_t n, Platform::PageSize pageSize, Policy policy, int bindNode);
+	// Platform::AllocatePopulated with the placement policy. The pages are faulted in by the mmap call which is why the policy
+	// is set for the calling thread around it instead of being bound to the mapping afterwards.
+	static void *AllocatePopulated(size_t n, Platform::PageSize pageSize, Policy policy, int bindNode);
+
+	// Pin the calling thread according to the affinity mode and return the node it was pinned to (-1 if not pinned)
+	static int PinThread(Affinity affinity, int threadIndex);
+
+	// Sample up to maxSamples pages of the range and return the fraction of resident pages which are located on node.
+	// Returns -1 if the page locations could not be determined.
+	static double GetLocalFraction(void *p, size_t n, int node, size_t maxSamples = 1024);
+	// Fraction of the given resident pages which are located on node, -1 if unknown
+	static double GetLocalFraction(const std::vector<void *> &pages, int node);
+
+	static bool ParsePolicy(const std::wstring &str, Policy &policy, int &bindNode);
+	static bool ParseAffinity(const std::wstring &str, Affinity &affinity);
+	static const wchar_t *ToString(Policy policy);
+	static const wchar_t *ToString(Affinity affinity);
+};
@@ -0,0 +1,142 @@
+#include "stdafx.h"
+#include "PerfCounters.h"
+
+#ifdef _WIN32
+
+// There is no per thread equivalent of perf_event_open on Windows. All counters are reported as not available.
+PerfCounters::PerfCounters()
+{
+	for (int i = 0; i < PerfCounterValues::Count; i++)
+	{
+		_Fds[i] = -1;
+	}
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+void PerfCounters::Start()
+{
+}
+
+void PerfCounters::Stop()
+{
+}
+
+PerfCounterValues PerfCounters::Read() const
+{
+	return PerfCounterValues();
+}
+
+bool PerfCounters::IsAvailable() const
+{
+	return false;
+}
+
+#else
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int OpenCounter(uint32_t type, uint64_t config)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_hv = 1;
+
+	// Page faults are handled in the kernel so we want to count kernel mode too. If this is not allowed
+	// (perf_event_paranoid >= 2 without CAP_PERFMON) fall back to user mode only.
+	int fd = (int)::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if (fd == -1)
+	{
+		attr.exclude_kernel = 1;
+		fd = (int)::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+	return fd;
+}
+
+static uint64_t CacheConfig(uint64_t cache, uint64_t op, uint64_t result)
+{
+	return cache | (op << 8) | (result << 16);
+}
+
+PerfCounters::PerfCounters()
+{
+	_Fds[PerfCounterValues::MinorFaults] = OpenCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN);
+	_Fds[PerfCounterValues::MajorFaults] = OpenCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ);
+	_Fds[PerfCounterValues::DTlbMisses] = OpenCounter(PERF_TYPE_HW_CACHE, CacheConfig(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+	_Fds[PerfCounterValues::ContextSwitches] = OpenCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+	_Fds[PerfCounterValues::Cycles] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	_Fds[PerfCounterValues::Instructions] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	_Fds[PerfCounterValues::LLCMisses] = OpenCounter(PERF_TYPE_HW_CACHE, CacheConfig(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+}
+
+PerfCounters::~PerfCounters()
+{
+	for (int fd : _Fds)
+	{
+		if (fd != -1)
+		{
+			::close(fd);
+		}
+	}
+}
+
+void PerfCounters::Start()
+{
+	for (int fd : _Fds)
+	{
+		if (fd != -1)
+		{
+			::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+}
+
+void PerfCounters::Stop()
+{
+	for (int fd : _Fds)
+	{
+		if (fd != -1)
+		{
+			::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+}
+
+PerfCounterValues PerfCounters::Read() const
+{
+	PerfCounterValues values;
+	for (int i = 0; i < PerfCounterValues::Count; i++)
+	{
+		uint64_t value = 0;
+		if (_Fds[i] != -1 && ::read(_Fds[i], &value, sizeof(value)) == sizeof(value))
+		{
+			values.Values[i] = value;
+			values.Available[i] = true;
+		}
+	}
+	return values;
+}
+
+bool PerfCounters::IsAvailable() const
+{
+	for (int fd : _Fds)
+	{
+		if (fd != -1)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+#endif
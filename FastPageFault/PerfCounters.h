@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Values of the hardware and kernel event counters which were collected for one measured region.
+// Counters which could not be opened (no PMU access in containers, perf_event_paranoid, Windows) are
+// marked as not available and printed as N.a.
+struct PerfCounterValues
+{
+	enum Counter
+	{
+		MinorFaults = 0,
+		MajorFaults,
+		DTlbMisses,
+		ContextSwitches,
+		Cycles,
+		Instructions,
+		LLCMisses,
+		Count
+	};
+
+	uint64_t Values[Count] = {};
+	bool Available[Count] = {};
+
+	// Sum the counters of different threads
+	void Add(const PerfCounterValues &other)
+	{
+		for (int i = 0; i < Count; i++)
+		{
+			Values[i] += other.Values[i];
+			Available[i] = Available[i] || other.Available[i];
+		}
+	}
+
+	// Column names which are appended to the tab separated output
+	static const wchar_t *GetHeader()
+	{
+		return L"\tMinFlt\tMajFlt\tdTLB_Miss\tCtxSw\tCycles\tInstr\tLLC_Miss";
+	}
+
+	std::wstring Format() const
+	{
+		std::wstring lret;
+		for (int i = 0; i < Count; i++)
+		{
+			lret += L"\t";
+			lret += Available[i] ? std::to_wstring(Values[i]) : L"N.a.";
+		}
+		return lret;
+	}
+};
+
+// Counts page faults, dTLB misses, context switches, cycles, instructions and LLC misses of the calling thread
+// between Start and Stop with perf_event_open. The counters must be created on the thread which is measured.
+class PerfCounters
+{
+public:
+	PerfCounters();
+	~PerfCounters();
+	void Start();
+	void Stop();
+	PerfCounterValues Read() const;
+
+	// True if at least one counter could be opened
+	bool IsAvailable() const;
+
+private:
+	PerfCounters(const PerfCounters &) = delete;
+	PerfCounters &operator=(const PerfCounters &) = delete;
+
+	int _Fds[PerfCounterValues::Count];
+};
+
+// Measures the calling thread from construction until destruction and stores the result in *pResult.
+// Does nothing when pResult is nullptr so callers do not need to check if counters are enabled.
+// The counters are opened once per thread and reused so that repeated measurements on worker threads
+// do not pay for perf_event_open inside the measured region.
+class PerfCounterScope
+{
+public:
+	PerfCounterScope(PerfCounterValues *pResult) : _pResult(pResult)
+	{
+		if (_pResult != nullptr)
+		{
+			GetThreadCounters().Start();
+		}
+	}
+
+	~PerfCounterScope()
+	{
+		if (_pResult != nullptr)
+		{
+			GetThreadCounters().Stop();
+			*_pResult = GetThreadCounters().Read();
+		}
+	}
+
+	static PerfCounters &GetThreadCounters()
+	{
+		static thread_local PerfCounters counters;
+		return counters;
+	}
+
+private:
+	PerfCounterScope(const PerfCounterScope &) = delete;
+	PerfCounterScope &operator=(const PerfCounterScope &) = delete;
+
+	PerfCounterValues *_pResult;
+};
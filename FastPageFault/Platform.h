@@ -0,0 +1,143 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Thin OS abstraction over the memory manager and file mapping APIs.
+// All tests go through these functions so that Windows and Linux measure the same operations
+// and print the same output. The Windows implementation lives in PlatformWindows.cpp, the Linux
+// implementation in PlatformLinux.cpp.
+struct Platform
+{
+#ifdef _WIN32
+	typedef HANDLE FileHandle;
+	typedef HANDLE MappingHandle;
+#else
+	typedef int FileHandle;
+	typedef int MappingHandle;
+#endif
+	static const FileHandle InvalidFile;
+
+	// Page size which backs anonymous memory
+	enum class PageSize
+	{
+		Default = 0,     // 4 KB pages
+		Large2MB = 1,    // explicit 2 MB pages (MAP_HUGETLB / MEM_LARGE_PAGES)
+		Huge1GB = 2,     // explicit 1 GB pages (MAP_HUGETLB | MAP_HUGE_1GB), Linux only
+		Transparent = 3, // transparent huge pages via madvise(MADV_HUGEPAGE), Linux only
+	};
+
+	// Access hint of a file mapping
+	enum class MapAdvice
+	{
+		Normal = 0,   // no hint, the default read ahead of the OS
+		Sequential,   // MADV_SEQUENTIAL: aggressive read ahead, Linux only
+		Random,       // MADV_RANDOM: no read ahead, Linux only
+		WillNeed,     // MADV_WILLNEED / PrefetchVirtualMemory: read the file asynchronously into the file system cache
+		HugePage,     // MADV_HUGEPAGE: file backed transparent huge pages (CONFIG_READ_ONLY_THP_FOR_FS), Linux only
+		Populate,     // MAP_POPULATE: read and map all pages while the file is mapped, Linux only
+	};
+
+	struct MemoryCounters
+	{
+		size_t WorkingSetBytes = 0;
+		size_t PeakWorkingSetBytes = 0;
+		uint64_t PageFaults = 0;       // soft + hard faults
+		uint64_t HardPageFaults = 0;   // only available on Linux, 0 on Windows
+	};
+
+	// ===== Virtual Memory =====
+	// Reserve address space without backing it with memory
+	static void *Reserve(size_t n);
+	// Commit previously reserved address space so it can be read and written
+	static bool Commit(void *p, size_t n);
+	// Reserve and commit in one go (VirtualAlloc MEM_RESERVE | MEM_COMMIT / anonymous mmap)
+	// n must be a multiple of GetPageSizeBytes(pageSize).
+	static void *Allocate(size_t n, PageSize pageSize = PageSize::Default);
+	// Allocate and fault in all pages during the allocation call (mmap MAP_POPULATE). Linux only.
+	static void *AllocatePopulated(size_t n, PageSize pageSize = PageSize::Default);
+	// Fault in all pages of an existing mapping for read or write access (madvise MADV_POPULATE_READ/WRITE, Linux 5.14+)
+	static bool Populate(void *p, size_t n, bool bWrite);
+	// Release memory which was returned by Reserve or Allocate
+	static bool Free(void *p, size_t n);
+	// Return the pages of an allocated range to the OS but keep the range usable. The next access faults in a zeroed page
+	// (decommit and commit / MADV_DONTNEED). With bLazy the OS takes the pages only when it runs short of memory and until
+	// then they keep their content and count to the working set (MEM_RESET / MADV_FREE).
+	static bool Discard(void *p, size_t n, bool bLazy);
+	// Let the C runtime heap keep up to trimBytes of free memory at the top of the heap and serve allocations below mmapBytes
+	// from the heap (mallopt M_TRIM_THRESHOLD / M_MMAP_THRESHOLD). This disables the dynamic thresholds of glibc. Linux only.
+	static bool SetHeapThresholds(size_t trimBytes, size_t mmapBytes);
+	// Restore the default thresholds of the C runtime heap (128 KB for glibc). glibc keeps its dynamic thresholds disabled. Linux only.
+	static bool ResetHeapThresholds();
+	// Return the free memory of the C runtime heap to the OS (malloc_trim / _heapmin)
+	static bool TrimHeap();
+	// Lock pages into the working set which will fault in all pages (VirtualLock / mlock)
+	static bool Lock(void *p, size_t n);
+	static bool Unlock(void *p, size_t n);
+	// Change the protection of committed pages to read only or read/write (VirtualProtect / mprotect)
+	static bool Protect(void *p, size_t n, bool bWriteable);
+	// Raise the limits for locked memory so Lock can succeed for large buffers
+	static bool GrowLockLimit(size_t additionalBytes, size_t maxBytes);
+	// Ask the OS to read the pages asynchronously into memory (PrefetchVirtualMemory / madvise(MADV_WILLNEED))
+	static bool Prefetch(void *p, size_t n);
+	static size_t GetPageSize();
+	// Granularity in bytes at which memory allocated with the given page size is faulted in
+	static size_t GetPageSizeBytes(PageSize pageSize);
+	// Whether Allocate can use the page size on this platform. Windows has no 1 GB and no transparent huge pages.
+	static bool IsSupported(PageSize pageSize);
+	// Fraction (0-1) of the small pages of the range which are resident (mincore / QueryWorkingSetEx), -1 on error
+	static double GetResidentFraction(void *p, size_t n);
+
+	// ===== Process Counters =====
+	static bool GetMemoryCounters(MemoryCounters &counters);
+	// Memory used by the page tables of the process (VmPTE of /proc/self/status). -1 if unknown (Windows).
+	static int64_t GetPageTableBytes();
+	// User and kernel CPU time of all threads of the process
+	static bool GetCpuTimes(std::chrono::nanoseconds &user, std::chrono::nanoseconds &system);
+
+	// ===== Files =====
+	static bool FileExists(const std::wstring &file);
+	static FileHandle OpenFileForRead(const std::wstring &file);
+	// Open a file for sequential reads with read ahead. bUnbuffered bypasses the file system cache (O_DIRECT / FILE_FLAG_NO_BUFFERING)
+	// which needs page aligned buffers, offsets and sizes.
+	static FileHandle OpenFileForSequentialRead(const std::wstring &file, bool bUnbuffered);
+	// Read up to n bytes at the current file position (read) or at offset (pread). read is 0 at the end of the file.
+	static bool ReadFile(FileHandle hFile, void *p, size_t n, size_t &read);
+	static bool ReadFileAt(FileHandle hFile, void *p, size_t n, uint64_t offset, size_t &read);
+	static FileHandle CreateWriteableFile(const std::wstring &file);
+	static bool WriteFile(FileHandle hFile, const void *p, size_t n);
+	// Write n bytes at offset (pwrite). Several threads can write to the same handle at different offsets.
+	static bool WriteFileAt(FileHandle hFile, const void *p, size_t n, uint64_t offset);
+	// Allocate the disk space of the file up front (fallocate / FileAllocationInfo) to avoid extending the file with every write
+	static bool PreallocateFile(FileHandle hFile, uint64_t size);
+	// Set the end of the file. With bSparse the unwritten ranges stay holes without disk space (FSCTL_SET_SPARSE on Windows).
+	static bool SetFileSize(FileHandle hFile, uint64_t size, bool bSparse);
+	static void CloseFile(FileHandle hFile);
+	// Returns false when the size could not be determined
+	static bool GetFileSize(FileHandle hFile, size_t &size);
+	// Map the whole file read only into the address space. Returns nullptr on failure.
+	// bPopulate reads and maps all pages during the call (MAP_POPULATE). Linux only.
+	static void *MapFile(FileHandle hFile, size_t size, MappingHandle &hMapping, bool bCopyOnWrite = false, bool bPopulate = false);
+	// Set the access hint of a file mapping. Populate must be passed to MapFile instead.
+	static bool AdviseMapping(void *p, size_t n, MapAdvice advice);
+	static void UnmapFile(void *p, size_t size, MappingHandle hMapping);
+	// Try to evict the file contents from the file system cache
+	static bool FlushFileCache(const std::wstring &file);
+	// Fraction (0-1) of the pages of the file which are in the file system cache (mincore), -1 when unknown. Linux only.
+	static double GetFileResidentFraction(const std::wstring &file);
+
+	// ===== Run metadata =====
+	static std::wstring GetCpuModel();
+	static std::wstring GetOsVersion();
+	static std::wstring GetHostName();
+	// Transparent huge page mode (always, madvise, never) or N.a. if the OS has no transparent huge pages
+	static std::wstring GetTransparentHugePageMode();
+
+	// Last OS error code (GetLastError / errno)
+	static int GetLastError();
+};
@@ -0,0 +1,575 @@
+#include "stdafx.h"
+#include "Platform.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+const Platform::FileHandle Platform::InvalidFile = -1;
+
+void *Platform::Reserve(size_t n)
+{
+	void *p = ::mmap(nullptr, n, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return p == MAP_FAILED ? nullptr : p;
+}
+
+bool Platform::Commit(void *p, size_t n)
+{
+	return ::mprotect(p, n, PROT_READ | PROT_WRITE) == 0;
+}
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+// Transparent huge pages are only used by the kernel for 2 MB aligned ranges. We over allocate
+// and trim the unaligned head and tail so that Free can release the memory with the original size.
+static void *AllocateTransparentHugePages(size_t n, int extraFlags)
+{
+	const size_t alignment = Platform::GetPageSizeBytes(Platform::PageSize::Transparent);
+	size_t mapped = n + alignment;
+	char *p = (char *)::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extraFlags, -1, 0);
+	if (p == MAP_FAILED)
+	{
+		return nullptr;
+	}
+
+	char *pAligned = (char *)(((uintptr_t)p + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	size_t head = pAligned - p;
+	size_t tail = mapped - head - n;
+	if (head > 0)
+	{
+		::munmap(p, head);
+	}
+	if (tail > 0)
+	{
+		::munmap(pAligned + n, tail);
+	}
+
+	if (::madvise(pAligned, n, MADV_HUGEPAGE) != 0)
+	{
+		int err = errno;
+		::munmap(pAligned, n);
+		errno = err;
+		return nullptr;
+	}
+
+	return pAligned;
+}
+
+static void *AllocateAnonymous(size_t n, Platform::PageSize pageSize, int extraFlags)
+{
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | extraFlags;
+	switch (pageSize)
+	{
+	case Platform::PageSize::Large2MB:
+		flags |= MAP_HUGETLB | MAP_HUGE_2MB;
+		break;
+	case Platform::PageSize::Huge1GB:
+		flags |= MAP_HUGETLB | MAP_HUGE_1GB;
+		break;
+	case Platform::PageSize::Transparent:
+		return AllocateTransparentHugePages(n, extraFlags);
+	default:
+		break;
+	}
+
+	void *p = ::mmap(nullptr, n, PROT_READ | PROT_WRITE, flags, -1, 0);
+	return p == MAP_FAILED ? nullptr : p;
+}
+
+void *Platform::Allocate(size_t n, PageSize pageSize)
+{
+	return AllocateAnonymous(n, pageSize, 0);
+}
+
+// With transparent huge pages MAP_POPULATE would fault in small pages before madvise(MADV_HUGEPAGE) is called
+// which is why the range is populated afterwards.
+void *Platform::AllocatePopulated(size_t n, PageSize pageSize)
+{
+	if (pageSize != PageSize::Transparent)
+	{
+		return AllocateAnonymous(n, pageSize, MAP_POPULATE);
+	}
+
+	void *p = AllocateAnonymous(n, pageSize, 0);
+	if (p != nullptr && !Populate(p, n, true))
+	{
+		int err = errno;
+		Free(p, n);
+		errno = err;
+		return nullptr;
+	}
+	return p;
+}
+
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22
+#endif
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+#ifndef MADV_FREE
+#define MADV_FREE 8
+#endif
+
+bool Platform::Populate(void *p, size_t n, bool bWrite)
+{
+	return ::madvise(p, n, bWrite ? MADV_POPULATE_WRITE : MADV_POPULATE_READ) == 0;
+}
+
+bool Platform::Free(void *p, size_t n)
+{
+	return ::munmap(p, n) == 0;
+}
+
+bool Platform::Discard(void *p, size_t n, bool bLazy)
+{
+	return ::madvise(p, n, bLazy ? MADV_FREE : MADV_DONTNEED) == 0;
+}
+
+bool Platform::SetHeapThresholds(size_t trimBytes, size_t mmapBytes)
+{
+	return ::mallopt(M_TRIM_THRESHOLD, (int)(std::min)(trimBytes, (size_t)INT_MAX)) == 1 &&
+		::mallopt(M_MMAP_THRESHOLD, (int)(std::min)(mmapBytes, (size_t)INT_MAX)) == 1;
+}
+
+bool Platform::ResetHeapThresholds()
+{
+	const size_t defaultThreshold = 128 * 1024;   // DEFAULT_TRIM_THRESHOLD and DEFAULT_MMAP_THRESHOLD_MIN of glibc
+	return SetHeapThresholds(defaultThreshold, defaultThreshold);
+}
+
+bool Platform::TrimHeap()
+{
+	::malloc_trim(0);
+	return true;
+}
+
+bool Platform::Lock(void *p, size_t n)
+{
+	return ::mlock(p, n) == 0;
+}
+
+bool Platform::Unlock(void *p, size_t n)
+{
+	return ::munlock(p, n) == 0;
+}
+
+bool Platform::Protect(void *p, size_t n, bool bWriteable)
+{
+	return ::mprotect(p, n, bWriteable ? PROT_READ | PROT_WRITE : PROT_READ) == 0;
+}
+
+// There is no working set size on Linux. The equivalent restriction is RLIMIT_MEMLOCK
+// which we raise as far as the hard limit allows.
+bool Platform::GrowLockLimit(size_t additionalBytes, size_t maxBytes)
+{
+	rlimit limit;
+	if (::getrlimit(RLIMIT_MEMLOCK, &limit) != 0)
+	{
+		return false;
+	}
+
+	rlim_t wanted = (rlim_t)maxBytes;
+	if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur + additionalBytes > wanted)
+	{
+		wanted = limit.rlim_cur + additionalBytes;
+	}
+	if (limit.rlim_max != RLIM_INFINITY && wanted > limit.rlim_max)
+	{
+		wanted = limit.rlim_max;
+	}
+	if (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur >= wanted)
+	{
+		return true;
+	}
+
+	limit.rlim_cur = wanted;
+	return ::setrlimit(RLIMIT_MEMLOCK, &limit) == 0;
+}
+
+bool Platform::Prefetch(void *p, size_t n)
+{
+	return ::madvise(p, n, MADV_WILLNEED) == 0;
+}
+
+size_t Platform::GetPageSize()
+{
+	return (size_t) ::sysconf(_SC_PAGESIZE);
+}
+
+size_t Platform::GetPageSizeBytes(PageSize pageSize)
+{
+	switch (pageSize)
+	{
+	case PageSize::Large2MB:
+	case PageSize::Transparent:
+		return 2 * 1024 * 1024;
+	case PageSize::Huge1GB:
+		return 1024ULL * 1024 * 1024;
+	default:
+		return GetPageSize();
+	}
+}
+
+bool Platform::IsSupported(PageSize)
+{
+	return true;
+}
+
+double Platform::GetResidentFraction(void *p, size_t n)
+{
+	const size_t pageSize = GetPageSize();
+	size_t pages = (n + pageSize - 1) / pageSize;
+	if (pages == 0)
+	{
+		return -1;
+	}
+
+	std::vector<unsigned char> residency(pages);
+	if (::mincore(p, n, residency.data()) != 0)
+	{
+		return -1;
+	}
+
+	size_t resident = 0;
+	for (unsigned char page : residency)
+	{
+		resident += page & 1;
+	}
+	return (double)resident / pages;
+}
+
+bool Platform::GetCpuTimes(std::chrono::nanoseconds &user, std::chrono::nanoseconds &system)
+{
+	rusage usage;
+	if (::getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return false;
+	}
+
+	user = std::chrono::seconds(usage.ru_utime.tv_sec) + std::chrono::microseconds(usage.ru_utime.tv_usec);
+	system = std::chrono::seconds(usage.ru_stime.tv_sec) + std::chrono::microseconds(usage.ru_stime.tv_usec);
+	return true;
+}
+
+// getrusage delivers the fault counters and the peak working set. The current working set (RSS)
+// is only available via /proc/self/statm.
+bool Platform::GetMemoryCounters(MemoryCounters &counters)
+{
+	rusage usage;
+	if (::getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return false;
+	}
+
+	counters.PeakWorkingSetBytes = (size_t)usage.ru_maxrss * 1024;
+	counters.PageFaults = (uint64_t)usage.ru_minflt + (uint64_t)usage.ru_majflt;
+	counters.HardPageFaults = (uint64_t)usage.ru_majflt;
+
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (statm != nullptr)
+	{
+		unsigned long long size = 0, resident = 0;
+		if (fscanf(statm, "%llu %llu", &size, &resident) == 2)
+		{
+			counters.WorkingSetBytes = (size_t)resident * GetPageSize();
+		}
+		fclose(statm);
+	}
+
+	return true;
+}
+
+int64_t Platform::GetPageTableBytes()
+{
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+	{
+		long long kb = 0;
+		if (sscanf(line.c_str(), "VmPTE: %lld kB", &kb) == 1)
+		{
+			return kb * 1024;
+		}
+	}
+	return -1;
+}
+
+bool Platform::FileExists(const std::wstring &file)
+{
+	struct stat st;
+	return ::stat(StringExtensions::ToNarrow(file).c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+Platform::FileHandle Platform::OpenFileForRead(const std::wstring &file)
+{
+	FileHandle hFile = ::open(StringExtensions::ToNarrow(file).c_str(), O_RDONLY);
+	if (hFile != InvalidFile)
+	{
+		// same as FILE_FLAG_RANDOM_ACCESS on Windows
+		::posix_fadvise(hFile, 0, 0, POSIX_FADV_RANDOM);
+	}
+	return hFile;
+}
+
+Platform::FileHandle Platform::OpenFileForSequentialRead(const std::wstring &file, bool bUnbuffered)
+{
+	FileHandle hFile = ::open(StringExtensions::ToNarrow(file).c_str(), O_RDONLY | (bUnbuffered ? O_DIRECT : 0));
+	if (hFile != InvalidFile && !bUnbuffered)
+	{
+		::posix_fadvise(hFile, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+	return hFile;
+}
+
+bool Platform::ReadFile(FileHandle hFile, void *p, size_t n, size_t &read)
+{
+	ssize_t lret;
+	do
+	{
+		lret = ::read(hFile, p, n);
+	} while (lret < 0 && errno == EINTR);
+
+	read = lret < 0 ? 0 : (size_t)lret;
+	return lret >= 0;
+}
+
+bool Platform::ReadFileAt(FileHandle hFile, void *p, size_t n, uint64_t offset, size_t &read)
+{
+	ssize_t lret;
+	do
+	{
+		lret = ::pread(hFile, p, n, (off_t)offset);
+	} while (lret < 0 && errno == EINTR);
+
+	read = lret < 0 ? 0 : (size_t)lret;
+	return lret >= 0;
+}
+
+Platform::FileHandle Platform::CreateWriteableFile(const std::wstring &file)
+{
+	return ::open(StringExtensions::ToNarrow(file).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+bool Platform::WriteFile(FileHandle hFile, const void *p, size_t n)
+{
+	const char *pData = (const char *)p;
+	while (n > 0)
+	{
+		ssize_t written = ::write(hFile, pData, n);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		pData += written;
+		n -= (size_t)written;
+	}
+	return true;
+}
+
+bool Platform::WriteFileAt(FileHandle hFile, const void *p, size_t n, uint64_t offset)
+{
+	const char *pData = (const char *)p;
+	while (n > 0)
+	{
+		ssize_t written = ::pwrite(hFile, pData, n, (off_t)offset);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		pData += written;
+		offset += written;
+		n -= (size_t)written;
+	}
+	return true;
+}
+
+bool Platform::PreallocateFile(FileHandle hFile, uint64_t size)
+{
+	return ::fallocate(hFile, 0, 0, (off_t)size) == 0;
+}
+
+// Files are sparse on Linux file systems by default
+bool Platform::SetFileSize(FileHandle hFile, uint64_t size, bool)
+{
+	return ::ftruncate(hFile, (off_t)size) == 0;
+}
+
+void Platform::CloseFile(FileHandle hFile)
+{
+	if (hFile != InvalidFile)
+	{
+		::close(hFile);
+	}
+}
+
+bool Platform::GetFileSize(FileHandle hFile, size_t &size)
+{
+	struct stat st;
+	if (::fstat(hFile, &st) != 0)
+	{
+		return false;
+	}
+
+	size = (size_t)st.st_size;
+	return true;
+}
+
+// A copy on write mapping is a private writeable mapping. The first write to a page copies it from the page cache.
+void *Platform::MapFile(FileHandle hFile, size_t size, MappingHandle &hMapping, bool bCopyOnWrite, bool bPopulate)
+{
+	hMapping = 0; // mmap needs no extra mapping object
+	int populate = bPopulate ? MAP_POPULATE : 0;
+	void *p = bCopyOnWrite ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | populate, hFile, 0)
+	                       : ::mmap(nullptr, size, PROT_READ, MAP_SHARED | populate, hFile, 0);
+	return p == MAP_FAILED ? nullptr : p;
+}
+
+bool Platform::AdviseMapping(void *p, size_t n, MapAdvice advice)
+{
+	switch (advice)
+	{
+	case MapAdvice::Normal:
+		return ::madvise(p, n, MADV_NORMAL) == 0;
+	case MapAdvice::Sequential:
+		return ::madvise(p, n, MADV_SEQUENTIAL) == 0;
+	case MapAdvice::Random:
+		return ::madvise(p, n, MADV_RANDOM) == 0;
+	case MapAdvice::WillNeed:
+		return ::madvise(p, n, MADV_WILLNEED) == 0;
+	case MapAdvice::HugePage:
+		return ::madvise(p, n, MADV_HUGEPAGE) == 0;
+	default:
+		errno = EINVAL;
+		return false;
+	}
+}
+
+void Platform::UnmapFile(void *p, size_t size, MappingHandle)
+{
+	if (p != nullptr)
+	{
+		::munmap(p, size);
+	}
+}
+
+bool Platform::FlushFileCache(const std::wstring &file)
+{
+	int fd = ::open(StringExtensions::ToNarrow(file).c_str(), O_RDONLY);
+	if (fd == -1)
+	{
+		return false;
+	}
+
+	// dirty pages cannot be dropped before they are written back
+	::fsync(fd);
+	bool lret = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	::close(fd);
+	return lret;
+}
+
+// mincore reports the page cache state of a file mapping without faulting the pages in
+double Platform::GetFileResidentFraction(const std::wstring &file)
+{
+	FileHandle hFile = ::open(StringExtensions::ToNarrow(file).c_str(), O_RDONLY);
+	size_t size = 0;
+	if (hFile == InvalidFile || !GetFileSize(hFile, size) || size == 0)
+	{
+		CloseFile(hFile);
+		return -1;
+	}
+
+	double lret = -1;
+	void *p = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, hFile, 0);
+	if (p != MAP_FAILED)
+	{
+		lret = GetResidentFraction(p, size);
+		::munmap(p, size);
+	}
+	CloseFile(hFile);
+	return lret;
+}
+
+std::wstring Platform::GetCpuModel()
+{
+	std::ifstream cpuinfo("/proc/cpuinfo");
+	std::string line;
+	while (std::getline(cpuinfo, line))
+	{
+		size_t colon = line.find(':');
+		if (line.compare(0, 10, "model name") == 0 && colon != std::string::npos)
+		{
+			// some VMs and emulators report an empty model name
+			size_t start = line.find_first_not_of(' ', colon + 1);
+			return start == std::string::npos ? L"N.a." : StringExtensions::ToWide(line.c_str() + start);
+		}
+	}
+	return L"N.a.";
+}
+
+std::wstring Platform::GetOsVersion()
+{
+	struct utsname name;
+	if (::uname(&name) != 0)
+	{
+		return L"N.a.";
+	}
+	return StringExtensions::ToWide((std::string(name.sysname) + " " + name.release + " " + name.machine).c_str());
+}
+
+std::wstring Platform::GetHostName()
+{
+	char name[256] = {};
+	if (::gethostname(name, sizeof(name) - 1) != 0)
+	{
+		return L"N.a.";
+	}
+	return StringExtensions::ToWide(name);
+}
+
+// The active mode is shown in brackets e.g. "always [madvise] never"
+std::wstring Platform::GetTransparentHugePageMode()
+{
+	std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+	std::string modes;
+	std::getline(file, modes);
+	size_t start = modes.find('[');
+	size_t end = modes.find(']');
+	if (start == std::string::npos || end == std::string::npos || end < start)
+	{
+		return L"N.a.";
+	}
+	return StringExtensions::ToWide(modes.substr(start + 1, end - start - 1).c_str());
+}
+
+int Platform::GetLastError()
+{
+	return errno;
+}
+
+#endif
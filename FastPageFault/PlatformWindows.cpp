@@ -0,0 +1,437 @@
+#include "stdafx.h"
+#include "Platform.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#include <psapi.h>
+
+const Platform::FileHandle Platform::InvalidFile = INVALID_HANDLE_VALUE;
+
+void *Platform::Reserve(size_t n)
+{
+	return ::VirtualAlloc(NULL, n, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+bool Platform::Commit(void *p, size_t n)
+{
+	return ::VirtualAlloc(p, n, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+// Large pages need the SeLockMemoryPrivilege which must be enabled for the process token before
+// the first allocation.
+static bool EnableLockMemoryPrivilege()
+{
+	HANDLE hToken = nullptr;
+	if (!::OpenProcessToken(::GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))
+	{
+		return false;
+	}
+
+	TOKEN_PRIVILEGES privileges;
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	bool lret = ::LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+				::AdjustTokenPrivileges(hToken, FALSE, &privileges, 0, nullptr, nullptr) &&
+				::GetLastError() == ERROR_SUCCESS;
+	::CloseHandle(hToken);
+	return lret;
+}
+
+void *Platform::Allocate(size_t n, PageSize pageSize)
+{
+	switch (pageSize)
+	{
+	case PageSize::Default:
+		return ::VirtualAlloc(NULL, n, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	case PageSize::Large2MB:
+	{
+		static bool bPrivilegeEnabled = EnableLockMemoryPrivilege();
+		if (!bPrivilegeEnabled)
+		{
+			return nullptr;
+		}
+		return ::VirtualAlloc(NULL, n, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+	}
+	default:
+		::SetLastError(ERROR_NOT_SUPPORTED);
+		return nullptr;
+	}
+}
+
+void *Platform::AllocatePopulated(size_t, PageSize)
+{
+	::SetLastError(ERROR_NOT_SUPPORTED);
+	return nullptr;
+}
+
+bool Platform::Populate(void *, size_t, bool)
+{
+	::SetLastError(ERROR_NOT_SUPPORTED);
+	return false;
+}
+
+bool Platform::Free(void *p, size_t)
+{
+	return ::VirtualFree(p, 0, MEM_RELEASE) == TRUE;
+}
+
+bool Platform::Discard(void *p, size_t n, bool bLazy)
+{
+	if (bLazy)
+	{
+		return ::VirtualAlloc(p, n, MEM_RESET, PAGE_READWRITE) != nullptr;
+	}
+	return ::VirtualFree(p, n, MEM_DECOMMIT) == TRUE && ::VirtualAlloc(p, n, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+}
+
+bool Platform::SetHeapThresholds(size_t, size_t)
+{
+	::SetLastError(ERROR_NOT_SUPPORTED);
+	return false;
+}
+
+bool Platform::ResetHeapThresholds()
+{
+	::SetLastError(ERROR_NOT_SUPPORTED);
+	return false;
+}
+
+bool Platform::TrimHeap()
+{
+	return _heapmin() == 0;
+}
+
+bool Platform::Lock(void *p, size_t n)
+{
+	return ::VirtualLock(p, n) == TRUE;
+}
+
+bool Platform::Unlock(void *p, size_t n)
+{
+	return ::VirtualUnlock(p, n) == TRUE;
+}
+
+bool Platform::Protect(void *p, size_t n, bool bWriteable)
+{
+	DWORD oldProtect = 0;
+	return ::VirtualProtect(p, n, bWriteable ? PAGE_READWRITE : PAGE_READONLY, &oldProtect) == TRUE;
+}
+
+bool Platform::GrowLockLimit(size_t additionalBytes, size_t maxBytes)
+{
+	MemoryCounters counters;
+	if (!GetMemoryCounters(counters))
+	{
+		return false;
+	}
+
+	return ::SetProcessWorkingSetSize(::GetCurrentProcess(), counters.WorkingSetBytes + additionalBytes, maxBytes) == TRUE;
+}
+
+bool Platform::Prefetch(void *p, size_t n)
+{
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.NumberOfBytes = n;
+	range.VirtualAddress = p;
+
+	return ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0) == TRUE;
+}
+
+size_t Platform::GetPageSize()
+{
+	SYSTEM_INFO info;
+	::GetSystemInfo(&info);
+	return info.dwPageSize;
+}
+
+size_t Platform::GetPageSizeBytes(PageSize pageSize)
+{
+	switch (pageSize)
+	{
+	case PageSize::Large2MB:
+		return ::GetLargePageMinimum();
+	case PageSize::Huge1GB:
+		return 1024ULL * 1024 * 1024;
+	case PageSize::Transparent:
+		return 2 * 1024 * 1024;
+	default:
+		return GetPageSize();
+	}
+}
+
+bool Platform::IsSupported(PageSize pageSize)
+{
+	return pageSize == PageSize::Default || pageSize == PageSize::Large2MB;
+}
+
+double Platform::GetResidentFraction(void *p, size_t n)
+{
+	const size_t pageSize = GetPageSize();
+	size_t pages = (n + pageSize - 1) / pageSize;
+	if (pages == 0)
+	{
+		return -1;
+	}
+
+	std::vector<PSAPI_WORKING_SET_EX_INFORMATION> infos(pages);
+	for (size_t page = 0; page < pages; page++)
+	{
+		infos[page].VirtualAddress = (char *)p + page * pageSize;
+	}
+
+	if (!::QueryWorkingSetEx(::GetCurrentProcess(), infos.data(), (DWORD)(infos.size() * sizeof(infos[0]))))
+	{
+		return -1;
+	}
+
+	size_t resident = 0;
+	for (auto &info : infos)
+	{
+		resident += info.VirtualAttributes.Valid ? 1 : 0;
+	}
+	return (double)resident / pages;
+}
+
+bool Platform::GetMemoryCounters(MemoryCounters &counters)
+{
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!::GetProcessMemoryInfo(::GetCurrentProcess(), &pmc, sizeof(pmc)))
+	{
+		return false;
+	}
+
+	counters.WorkingSetBytes = pmc.WorkingSetSize;
+	counters.PeakWorkingSetBytes = pmc.PeakWorkingSetSize;
+	counters.PageFaults = pmc.PageFaultCount;
+	counters.HardPageFaults = 0;
+	return true;
+}
+
+int64_t Platform::GetPageTableBytes()
+{
+	return -1;
+}
+
+bool Platform::GetCpuTimes(std::chrono::nanoseconds &user, std::chrono::nanoseconds &system)
+{
+	FILETIME creation, exit, kernel, userTime;
+	if (!::GetProcessTimes(::GetCurrentProcess(), &creation, &exit, &kernel, &userTime))
+	{
+		return false;
+	}
+
+	// FILETIME counts in 100 ns units
+	user = std::chrono::nanoseconds(((((uint64_t)userTime.dwHighDateTime) << 32) + userTime.dwLowDateTime) * 100);
+	system = std::chrono::nanoseconds(((((uint64_t)kernel.dwHighDateTime) << 32) + kernel.dwLowDateTime) * 100);
+	return true;
+}
+
+bool Platform::FileExists(const std::wstring &file)
+{
+	DWORD dwAttrib = ::GetFileAttributes(file.c_str());
+
+	return (dwAttrib != INVALID_FILE_ATTRIBUTES &&
+		!(dwAttrib & FILE_ATTRIBUTE_DIRECTORY));
+}
+
+Platform::FileHandle Platform::OpenFileForRead(const std::wstring &file)
+{
+	return ::CreateFile(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+}
+
+Platform::FileHandle Platform::OpenFileForSequentialRead(const std::wstring &file, bool bUnbuffered)
+{
+	return ::CreateFile(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, bUnbuffered ? FILE_FLAG_NO_BUFFERING : FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+}
+
+bool Platform::ReadFile(FileHandle hFile, void *p, size_t n, size_t &read)
+{
+	DWORD dwRead = 0;
+	bool lret = ::ReadFile(hFile, p, (DWORD)n, &dwRead, nullptr) == TRUE;
+	read = dwRead;
+	return lret;
+}
+
+// The offset of a synchronous handle is passed in the OVERLAPPED structure
+bool Platform::ReadFileAt(FileHandle hFile, void *p, size_t n, uint64_t offset, size_t &read)
+{
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = (DWORD)offset;
+	overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+	DWORD dwRead = 0;
+	bool lret = ::ReadFile(hFile, p, (DWORD)n, &dwRead, &overlapped) == TRUE || ::GetLastError() == ERROR_HANDLE_EOF;
+	read = dwRead;
+	return lret;
+}
+
+Platform::FileHandle Platform::CreateWriteableFile(const std::wstring &file)
+{
+	return ::CreateFile(file.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_FLAG_RANDOM_ACCESS, nullptr);
+}
+
+bool Platform::WriteFile(FileHandle hFile, const void *p, size_t n)
+{
+	DWORD dwWritten = 0;
+	return ::WriteFile(hFile, p, (DWORD)n, &dwWritten, nullptr) == TRUE && dwWritten == n;
+}
+
+bool Platform::WriteFileAt(FileHandle hFile, const void *p, size_t n, uint64_t offset)
+{
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = (DWORD)offset;
+	overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+	DWORD dwWritten = 0;
+	return ::WriteFile(hFile, p, (DWORD)n, &dwWritten, &overlapped) == TRUE && dwWritten == n;
+}
+
+bool Platform::PreallocateFile(FileHandle hFile, uint64_t size)
+{
+	FILE_ALLOCATION_INFO info;
+	info.AllocationSize.QuadPart = (LONGLONG)size;
+	return ::SetFileInformationByHandle(hFile, FileAllocationInfo, &info, sizeof(info)) == TRUE;
+}
+
+bool Platform::SetFileSize(FileHandle hFile, uint64_t size, bool bSparse)
+{
+	DWORD dwReturned = 0;
+	if (bSparse && !::DeviceIoControl(hFile, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &dwReturned, nullptr))
+	{
+		return false;
+	}
+
+	FILE_END_OF_FILE_INFO info;
+	info.EndOfFile.QuadPart = (LONGLONG)size;
+	return ::SetFileInformationByHandle(hFile, FileEndOfFileInfo, &info, sizeof(info)) == TRUE;
+}
+
+void Platform::CloseFile(FileHandle hFile)
+{
+	if (hFile != nullptr && hFile != InvalidFile)
+	{
+		::CloseHandle(hFile);
+	}
+}
+
+bool Platform::GetFileSize(FileHandle hFile, size_t &size)
+{
+	BY_HANDLE_FILE_INFORMATION fileInfo;
+
+	if (::GetFileInformationByHandle(hFile, &fileInfo) == FALSE)
+	{
+		return false;
+	}
+
+	size = (((size_t)fileInfo.nFileSizeHigh) << 32) + (size_t)fileInfo.nFileSizeLow;
+	return true;
+}
+
+void *Platform::MapFile(FileHandle hFile, size_t, MappingHandle &hMapping, bool bCopyOnWrite, bool bPopulate)
+{
+	if (bPopulate)
+	{
+		hMapping = NULL;
+		::SetLastError(ERROR_NOT_SUPPORTED);
+		return nullptr;
+	}
+
+	hMapping = ::CreateFileMapping(hFile, nullptr, bCopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+	if (hMapping == NULL)
+	{
+		return nullptr;
+	}
+
+	return ::MapViewOfFile(hMapping, bCopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+}
+
+// Windows knows only the prefetch. The read ahead is chosen when the file is opened (FILE_FLAG_RANDOM_ACCESS).
+bool Platform::AdviseMapping(void *p, size_t n, MapAdvice advice)
+{
+	switch (advice)
+	{
+	case MapAdvice::Normal:
+		return true;
+	case MapAdvice::WillNeed:
+		return Prefetch(p, n);
+	default:
+		::SetLastError(ERROR_NOT_SUPPORTED);
+		return false;
+	}
+}
+
+void Platform::UnmapFile(void *p, size_t, MappingHandle hMapping)
+{
+	if (p != nullptr)
+	{
+		::UnmapViewOfFile(p);
+	}
+
+	if (hMapping != NULL)
+	{
+		::CloseHandle(hMapping);
+	}
+}
+
+// Opening a file unbuffered flushes the file system cache for this file
+bool Platform::FlushFileCache(const std::wstring &file)
+{
+	HANDLE hUnbufferedHandle = ::CreateFile(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+	if (hUnbufferedHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	::CloseHandle(hUnbufferedHandle);
+	return true;
+}
+
+// Windows has no API to query the standby list pages of a single file
+double Platform::GetFileResidentFraction(const std::wstring &)
+{
+	return -1;
+}
+
+static std::wstring ReadRegistryString(const wchar_t *key, const wchar_t *value)
+{
+	wchar_t buffer[256] = {};
+	DWORD size = sizeof(buffer);
+	if (::RegGetValueW(HKEY_LOCAL_MACHINE, key, value, RRF_RT_REG_SZ, nullptr, buffer, &size) != ERROR_SUCCESS)
+	{
+		return L"N.a.";
+	}
+	return buffer;
+}
+
+std::wstring Platform::GetCpuModel()
+{
+	return ReadRegistryString(L"HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0", L"ProcessorNameString");
+}
+
+std::wstring Platform::GetOsVersion()
+{
+	const wchar_t *key = L"SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion";
+	return ReadRegistryString(key, L"ProductName") + L" build " + ReadRegistryString(key, L"CurrentBuild");
+}
+
+std::wstring Platform::GetHostName()
+{
+	wchar_t name[MAX_COMPUTERNAME_LENGTH + 1] = {};
+	DWORD size = MAX_COMPUTERNAME_LENGTH + 1;
+	if (!::GetComputerNameW(name, &size))
+	{
+		return L"N.a.";
+	}
+	return name;
+}
+
+std::wstring Platform::GetTransparentHugePageMode()
+{
+	return L"N.a.";
+}
+
+int Platform::GetLastError()
+{
+	return (int) ::GetLastError();
+}
+
+#endif
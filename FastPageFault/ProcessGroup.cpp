@@ -0,0 +1,246 @@
+#include "stdafx.h"
+#include "ProcessGroup.h"
+#include "TickCounter.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <new>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// ===== Platform independent parts =====
+
+void ProcessGroup::Barrier()
+{
+	int generation = _pShared->Generation.load();
+	if (_pShared->Arrived.fetch_add(1) + 1 == _ActiveProcesses)
+	{
+		_pShared->Arrived.store(0);
+		_pShared->Generation.fetch_add(1);
+		return;
+	}
+
+	while (_pShared->Generation.load() == generation && _pShared->Aborted.load() == 0)
+	{
+		std::this_thread::yield(); // let the other children run when there are more processes than cores
+	}
+}
+
+std::chrono::nanoseconds ProcessGroup::GetWallTime(size_t step) const
+{
+	uint64_t firstStart = UINT64_MAX, lastEnd = 0;
+	for (auto &results : _Results)
+	{
+		if (step < results.size() && results[step].Error == 0)
+		{
+			firstStart = (std::min)(firstStart, results[step].Start);
+			lastEnd = (std::max)(lastEnd, results[step].End);
+		}
+	}
+	return lastEnd == 0 ? std::chrono::nanoseconds(0) : std::chrono::nanoseconds((int64_t)TickCounter::ToNs(lastEnd - firstStart));
+}
+
+std::chrono::nanoseconds ProcessGroup::GetStartSkew(size_t step) const
+{
+	uint64_t first = UINT64_MAX, last = 0;
+	for (auto &results : _Results)
+	{
+		if (step < results.size() && results[step].Error == 0)
+		{
+			first = (std::min)(first, results[step].Start);
+			last = (std::max)(last, results[step].Start);
+		}
+	}
+	return last == 0 ? std::chrono::nanoseconds(0) : std::chrono::nanoseconds((int64_t)TickCounter::ToNs(last - first));
+}
+
+std::chrono::nanoseconds ProcessGroup::GetEndSkew(size_t step) const
+{
+	uint64_t first = UINT64_MAX, last = 0;
+	for (auto &results : _Results)
+	{
+		if (step < results.size() && results[step].Error == 0)
+		{
+			first = (std::min)(first, results[step].End);
+			last = (std::max)(last, results[step].End);
+		}
+	}
+	return last == 0 ? std::chrono::nanoseconds(0) : std::chrono::nanoseconds((int64_t)TickCounter::ToNs(last - first));
+}
+
+#ifdef _WIN32
+
+// Windows has no fork. Starting the children with CreateProcess would need the whole scenario state on the command line.
+ProcessGroup::ProcessGroup()
+{
+}
+
+ProcessGroup::~ProcessGroup()
+{
+}
+
+bool ProcessGroup::IsSupported()
+{
+	return false;
+}
+
+bool ProcessGroup::Run(int, std::function<std::vector<Result>(int)>)
+{
+	::SetLastError(ERROR_NOT_SUPPORTED);
+	return false;
+}
+
+#else
+
+ProcessGroup::ProcessGroup()
+{
+	void *p = ::mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (p != MAP_FAILED)
+	{
+		_pShared = new (p) SharedState();
+	}
+}
+
+ProcessGroup::~ProcessGroup()
+{
+	if (_pShared != nullptr)
+	{
+		_pShared->~SharedState();
+		::munmap(_pShared, sizeof(SharedState));
+	}
+}
+
+bool ProcessGroup::IsSupported()
+{
+	return true;
+}
+
+// Write the whole buffer also when the pipe accepts only a part of it
+static bool WriteAll(int fd, const void *p, size_t n)
+{
+	const char *pCur = (const char *)p;
+	while (n > 0)
+	{
+		ssize_t written = ::write(fd, pCur, n);
+		if (written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (written <= 0)
+		{
+			return false;
+		}
+		pCur += written;
+		n -= written;
+	}
+	return true;
+}
+
+static bool ReadAll(int fd, void *p, size_t n)
+{
+	char *pCur = (char *)p;
+	while (n > 0)
+	{
+		ssize_t read = ::read(fd, pCur, n);
+		if (read < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (read <= 0)
+		{
+			return false;
+		}
+		pCur += read;
+		n -= read;
+	}
+	return true;
+}
+
+bool ProcessGroup::Run(int nProcesses, std::function<std::vector<Result>(int processIndex)> work)
+{
+	if (_pShared == nullptr)
+	{
+		return false;
+	}
+
+	_pShared->Arrived.store(0);
+	_pShared->Generation.store(0);
+	_pShared->Aborted.store(0);
+	_ActiveProcesses = nProcesses;
+	_Results.assign(nProcesses, std::vector<Result>());
+
+	// buffered output would otherwise be printed by every child again
+	fflush(stdout);
+
+	std::vector<pid_t> children;
+	std::vector<int> pipes;
+	for (int i = 0; i < nProcesses; i++)
+	{
+		int fds[2];
+		pid_t pid = -1;
+		if (::pipe(fds) == 0)
+		{
+			pid = ::fork();
+			if (pid == -1)
+			{
+				::close(fds[0]);
+				::close(fds[1]);
+			}
+		}
+
+		if (pid == -1)
+		{
+			// let the already started children leave their barriers
+			_pShared->Aborted.store(1);
+			for (size_t child = 0; child < children.size(); child++)
+			{
+				::waitpid(children[child], nullptr, 0);
+				::close(pipes[child]);
+			}
+			return false;
+		}
+
+		if (pid == 0)
+		{
+			::close(fds[0]);
+			std::vector<Result> results = work(i);
+			uint32_t count = (uint32_t)results.size();
+			bool bSent = WriteAll(fds[1], &count, sizeof(count)) && (count == 0 || WriteAll(fds[1], results.data(), count * sizeof(Result)));
+			::_exit(bSent ? 0 : 1); // skip the destructors and atexit handlers of the copied parent state
+		}
+
+		::close(fds[1]);
+		children.push_back(pid);
+		pipes.push_back(fds[0]);
+	}
+
+	// The results are small enough to fit into the pipe buffer. The children can exit before their results are read
+	// which allows to release the waiting children as soon as one child died.
+	for (int i = 0; i < nProcesses; i++)
+	{
+		int status = 0;
+		if (::waitpid(-1, &status, 0) != -1 && !(WIFEXITED(status) && WEXITSTATUS(status) == 0))
+		{
+			_pShared->Aborted.store(1);
+		}
+	}
+
+	for (int i = 0; i < nProcesses; i++)
+	{
+		uint32_t count = 0;
+		if (ReadAll(pipes[i], &count, sizeof(count)))
+		{
+			_Results[i].resize(count);
+			if (count > 0 && !ReadAll(pipes[i], _Results[i].data(), count * sizeof(Result)))
+			{
+				_Results[i].clear();
+			}
+		}
+		::close(pipes[i]);
+	}
+	return true;
+}
+
+#endif
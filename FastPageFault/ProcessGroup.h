@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "PerfCounters.h"
+
+// Forked child processes for the multi process scenarios. Every child has its own address space so the processes
+// only contend on the system wide locks of the memory manager and not on the per process mmap_lock.
+// The children synchronize their measured steps with a spin barrier which lives in a shared anonymous mapping
+// and send their results to the parent over a pipe. Only supported on Linux.
+class ProcessGroup
+{
+public:
+	// One measured step of a child process
+	struct Result
+	{
+		uint64_t Start = 0;   // TickCounter ticks after the barrier
+		uint64_t End = 0;     // TickCounter ticks after the step has finished
+		uint64_t Bytes = 0;   // bytes touched or copied by the step
+		int Error = 0;        // error code if the child could not execute the step
+		PerfCounterValues Counters;
+	};
+
+	ProcessGroup();
+	~ProcessGroup();
+
+	static bool IsSupported();
+
+	// Fork nProcesses children which execute work(processIndex) and wait until all have exited.
+	// work must call Barrier() before every measured step and return one Result per step. Every child must
+	// call Barrier() equally often, also when its step fails. Returns false if the children could not be started.
+	bool Run(int nProcesses, std::function<std::vector<Result>(int processIndex)> work);
+
+	// Called by the children: wait until all children of the current Run have arrived
+	void Barrier();
+
+	// Results of the last Run
+	int GetProcessCount() const { return (int)_Results.size(); }
+	const std::vector<Result> &GetResults(int processIndex) const { return _Results[processIndex]; }
+	std::chrono::nanoseconds GetWallTime(size_t step) const;      // first start until last end of all processes
+	std::chrono::nanoseconds GetStartSkew(size_t step) const;     // first start until last start
+	std::chrono::nanoseconds GetEndSkew(size_t step) const;       // first end until last end
+
+private:
+	ProcessGroup(const ProcessGroup &) = delete;
+	ProcessGroup &operator=(const ProcessGroup &) = delete;
+
+	// Lives in memory which is shared between the parent and all children
+	struct SharedState
+	{
+		std::atomic<int> Arrived;
+		std::atomic<int> Generation;
+		std::atomic<int> Aborted;   // set by the parent when a child died so that the others do not wait forever
+	};
+
+	SharedState *_pShared = nullptr;
+	int _ActiveProcesses = 0;
+	std::vector<std::vector<Result>> _Results;
+};
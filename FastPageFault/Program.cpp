@@ -1,13 +1,14 @@
 #include "stdafx.h"
 #include "Program.h"
-#include <process.h>
-#include <psapi.h>
 #include <random>
 #include <memory>
 #include <array>
 #include <mutex>
+#include <cstring>
+#include <tuple>
 
 #include "Stopwatch.h"
+#include "TickCounter.h"
 
 using namespace FastPageFault;
 
@@ -15,33 +16,140 @@ Program::Program(std::queue<std::wstring> &&args)
 {
 	_Args = std::move(args);
 
+	// keep the original arguments for the run metadata because Parse consumes the queue
+	auto copy = _Args;
+	while (!copy.empty())
+	{
+		_CommandLine += (_CommandLine.empty() ? L"" : L" ") + copy.front();
+		copy.pop();
+	}
 }
 
 void Program::Help()
 {
 	const wchar_t* HelpStr =
-		L"FastPageFault [-N dd [-lock] [-touchthreads n] [-file xxx [-flush] [-mapthreads n]]] [-filemap xxx [-flush]] [-createfile dd xxx] [-wait]\n" \
+		L"FastPageFault [-N dd [-pagesize 4k|2m|1g|thp] [-lock] [-touchthreads n] [-file xxx [-flush] [-mapthreads n]]] [-filemap xxx [-flush]] [-createfile dd xxx] [-wait]\n" \
 		L"By Alois Kraus 2017 v1.0\n" \
 		L"  -N ddd          Allocate and touch ddd MB of memory\n" \
 		L"  -wait           Wait for keypress before exiting\n" \
 		L"  -touchthreads n Touch allocated memory by 1 up to n threads where each thread touches N/n bytes of memory to simulate a concurrent touch. Use n=all to run from 1-n hardware threads.\n" \
-		L"  -lock           Lock allocated memory (-N ddd) with VirtualLock before touching pages\n" \
+		L"  -numa xx        Memory placement of the -N and -memcopy buffers: local (node of the allocating thread), interleave,\n" \
+		L"                  firsttouch (node of the faulting thread) or bind:X to bind to node X.\n" \
+		L"  -affinity xx    Pin touch and copy threads: compact (fill node 0 first), scatter (round robin over nodes, one CPU per thread)\n" \
+		L"                  or pernode (round robin over nodes, any CPU of the node). With -numa or -affinity the results are additionally\n" \
+		L"                  reported per node with the throughput and the fraction of pages which are located on the node. With -affinity\n" \
+		L"                  every pass is repeated with the memory of each thread bound to its own node and to the next node to measure\n" \
+		L"                  the local and remote throughput.\n" \
+		L"  -pattern xx     Order in which -N and -filemap touch the pages: sequential (default), reverse, stride:N (every Nth page, then the\n" \
+		L"                  next offset), random (precomputed permutation) or interleaved (page i is touched by thread i %% n). Sequential, reverse\n" \
+		L"                  and stride give every thread a contiguous slice. Touch 2 always reads sequentially.\n" \
+		L"  -access xx      How -N and -filemap access every page: read (default, maps the shared zero page on Linux), write (allocates and\n" \
+		L"                  zeroes a new page), readthenwrite (a read pass followed by a write pass which breaks the copy on write of the zero\n" \
+		L"                  page, reported as read and cow) or rmw (read and write every page in one pass). Write modes map the -filemap file\n" \
+		L"                  private so that every write copies the page. Windows has no shared zero page and allocates on the first read.\n" \
+		L"  -histogram      Time every page touch of -N and -filemap and print the p50/p90/p99/p99.9/max fault latency per thread count.\n" \
+		L"                  The per page timing adds some overhead to Time_ms of the Touch 1 scenario.\n" \
+		L"  -perf           Count minor/major faults, dTLB misses, context switches, cycles, instructions and LLC misses with\n" \
+		L"                  perf_event_open per thread for -N, -memcopy and -filemap and append them as columns. Unavailable counters are printed as N.a.\n" \
+		L"  -format xx      Output format of the results: table (default, tab separated), csv or json. csv and json contain the run\n" \
+		L"                  metadata (host, CPU, cores, OS, page size, THP mode, NUMA layout, clock and arguments). Messages go to stderr.\n" \
+		L"  -tsc            Measure all durations with the invariant TSC of the CPU instead of the steady clock\n" \
+		L"  -pagesize xx    Back the -N and -memcopy buffers with 4k (default), 2m or 1g pages (MAP_HUGETLB / MEM_LARGE_PAGES) or\n" \
+		L"                  thp for transparent huge pages (madvise MADV_HUGEPAGE). us/Page is then reported per 2 MB or 1 GB page.\n" \
+		L"  -lock           Lock allocated memory (-N ddd) with VirtualLock (mlock on Linux) before touching pages\n" \
 		L"  -file xxx       Execute map/touch/unmap in a loop until the touch threads have finished measuring the soft page fault performance\n" \
-		L"   -flush         Flush the file system cache for the file before reading memory mapped file contents.\n" \
+		L"   -flush         Evict the file from the file system cache before reading memory mapped file contents. On Linux the file is\n" \
+		L"                  synced, dropped with posix_fadvise(POSIX_FADV_DONTNEED) and checked with mincore until no page is resident.\n" \
 		L"   -mapthreads n  Read the memory mapped file from n threads in a loop until the main touch operation has completed.\n" \
+		L"  -interfere xx   Run a background activity while -N is measured. Can be given several times. The format is kind[:threads[:rate]]\n" \
+		L"                  where rate is the number of operations per second and thread (0 = as fast as possible). kind is one of\n" \
+		L"                  mmap (map/touch/unmap 1 MB), mprotect (toggle 1 MB read only/read write), alloc (malloc/touch/free 16 KB-1 MB),\n" \
+		L"                  fork (fork a child which exits at once) or thp (fault and free 16 MB of transparent huge pages).\n" \
+		L"                  After the normal output Touch 1 is measured without, with every activity alone (also -file) and with all\n" \
+		L"                  activities to report the inflation of the time and the p99 page fault latency.\n" \
+		L"  -duration s     Sustained mode: allocate, touch with -touchthreads n threads and free the -N buffer in a loop for s seconds\n" \
+		L"  -iterations n   or n times (both can be combined) and print a time series with MB/s, us/Page, the page fault latency\n" \
+		L"                  percentiles, the resident set size and the page faults of every interval.\n" \
+		L"   -interval ms   Length of a sample interval of the sustained mode. Default is 1000 ms.\n" \
+		L"  -processes n    Run the -N, -memcopy or -filemap scenario in 1 up to n forked child processes (n=all for all cores) instead of threads.\n" \
+		L"                  Every process uses its own buffer or mapping and all processes start each step through a shared memory barrier.\n" \
+		L"                  The aggregate and the per process throughput are reported. Not supported on Windows and ignores -histogram.\n" \
+		L"  -repeat n       Execute the scenario n times and print per configuration and metric the mean, median, standard deviation,\n" \
+		L"                  min, max and the 95%% confidence interval of the mean in a <table>_stats table instead of the single runs.\n" \
+		L"   -warmup n      Execute the scenario n times before the measured runs and discard their results.\n" \
+		L"   -outliers      Reject values which are more than 3 median absolute deviations away from the median from the statistics.\n" \
+		L"  -save xxx       Save the results of all measured runs to the file xxx for a later -compare.\n" \
 		L"  ===== Memory Copy Tests =====\n" \
 		L"  -memcopy N        Copy from an equally sized source buffer data to a destination buffer which is on first copy soft faulted into the current process\n" \
 		L"  -memcopythreads n Copy from 1 up to n threads N/n bytes from its own thread to determine when the soft page fault spin lock overhead becomes bigger than the gains from a parallel memcpy\n" \
 		L"                    If n=all then the test is repeated performed in steps from 1 up to all physical cores.\n" \
+		L"  -kernels xx       Comma separated list of copy loops: memcpy (default), movsb (rep movsb), avx2, avx512 (aligned SIMD loops),\n" \
+		L"                    nt (streaming stores of the widest supported width and sfence), prefault (touch every destination page,\n" \
+		L"                    then memcpy) or all for every kernel this CPU supports. The MB/s of Touch_1 and Touch_2 are printed side by side.\n" \
+		L"  ===== Memory Bandwidth Tests =====\n" \
+		L"  -bandwidth N      Measure the STREAM kernels read, write, copy, scale and triad on resident buffers of 16 KB up to N MB\n" \
+		L"                    in steps of 4x (L1, L2, L3 cache and DRAM) and report the best of 3 trials. MB/s counts every read and written\n" \
+		L"                    array element like STREAM. -pagesize, -numa and -affinity are honored.\n" \
+		L"  -bandwidththreads n Run every step from 1 up to n threads (n=all for all cores) which share the buffers.\n" \
+		L"  ===== Size Sweep =====\n" \
+		L"  -sweep min:max[:f] Touch (all -access passes) and copy (Touch_1 and Touch_2) buffers from min up to max MB which grow by\n" \
+		L"                    the factor f (default 2) with one thread. Every step reports us/Page, the page faults and the growth of the\n" \
+		L"                    page tables (VmPTE, N.a. on Windows) while the buffers are mapped. -pagesize, -pattern and -numa are honored.\n" \
+		L"  ===== Allocator Tests =====\n" \
+		L"  -allocators N     Allocate N MB in -blocksize blocks, write every page and release all blocks -iterations times (default 20)\n" \
+		L"                    for every allocation strategy. The first iteration is reported separately (First_ms, First_Faults) from the\n" \
+		L"                    steady state of the following iterations (time, throughput and page faults per iteration) together with the\n" \
+		L"                    memory which is still resident after the last release. -pagesize is not supported.\n" \
+		L"    -strategies xx  Comma separated list of mmap (map/unmap every block), arena (retained arena which is only reset), dontneed\n" \
+		L"                    (arena discarded with MADV_DONTNEED), free (arena discarded with MADV_FREE), malloc (glibc defaults) and\n" \
+		L"                    malloc:T (M_TRIM_THRESHOLD T MB, Linux only) or all (default). malloc:T runs after the other strategies.\n" \
+		L"    -blocksize kb   Size of one block in KB. Default is 256 KB which is above the initial glibc mmap threshold of 128 KB.\n" \
+		L"  ===== Pre-faulting Tests =====\n" \
+		L"  -prefault dd      Compare the time until a dd MB buffer is fully resident and the cost of the first write afterwards for\n" \
+		L"                    none, MAP_POPULATE, MADV_POPULATE_READ/WRITE, mlock and a user space pre-touch from 1 up to -touchthreads n threads.\n" \
+		L"                    -pagesize, -numa and -affinity are honored. MAP_POPULATE gets the -numa policy as thread memory policy.\n" \
 		L"  ===== File Mapping Tests =====\n" \
 		L"  -filemap xxx    Read a memory mapped file via page faults into memory\n" \
-		L"    -prefetch     Execute PrefetchVirtualMemory and sleep for 10s before touching the pages\n" \
+		L"    -prefetch     Execute PrefetchVirtualMemory (madvise MADV_WILLNEED on Linux) and wait until the file is resident before\n" \
+		L"                  touching the pages. The wait ends when all pages are resident, no page was read for 100 ms or after 10s.\n" \
+		L"    -advice xx    Comma separated list of mapping hints which are measured one after the other: normal (default), sequential,\n" \
+		L"                  random, willneed (same as -prefetch), hugepage (file backed THP) or populate (MAP_POPULATE) or all.\n" \
+		L"                  Only normal and willneed are supported on Windows. Use -flush to start every hint with a cold cache.\n" \
+		L"    -cache pct[:layout] Evict the file and read pct percent of its pages back into the file system cache before every\n" \
+		L"                  trial of -filemap and -ingest (where it is an additional cache state). layout selects the pages: head (default),\n" \
+		L"                  tail, interleaved (evenly spread) or random. Cached_%% shows the resident part measured with mincore (N.a. on Windows).\n" \
+		L"    -readahead kb Prefetch the next kb KB whenever the touch reaches the end of the previous window (sequential pattern only, rounded up to whole pages).\n" \
+		L"    -mapthreads n Additionally fault the file from 1 up to n threads (n=all for all cores) with the first access mode.\n" \
+		L"    -mapmode xx   How the threads map the file: shared (one mapping, every thread touches its part), overlapping (one mapping,\n" \
+		L"                  every thread touches all pages), private (every thread maps the file itself and touches its part) or all (default).\n" \
+		L"                  Shared and overlapping mappings contend on the page table and mapping locks of the single VMA.\n" \
+		L"  ===== File Ingest Tests =====\n" \
+		L"  -ingest xxx     Load the file xxx completely into memory with mmap (fault every page), buffered read, pread, O_DIRECT\n" \
+		L"                  (FILE_FLAG_NO_BUFFERING) and io_uring (Linux only) with a cold and a warm file system cache and report\n" \
+		L"                  the throughput and the user and kernel CPU time of the process.\n" \
+		L"   -methods xx    Comma separated list of mmap, read, pread, direct and uring. Default are all supported methods.\n" \
+		L"   -buffers kb    Comma separated list of read buffer sizes in KB for read, pread, direct and uring. Default is 4,64,1024.\n" \
+		L"   -ingestthreads n  pread the file from 1 up to n threads (n=all for all cores) where every thread reads its own part.\n" \
+		L"   -queuedepth n  Number of io_uring reads in flight. Default is 32.\n" \
+		L"  ===== Comparing Results =====\n" \
+		L"  -compare base current  Compare two files written with -save. Rows are matched by table and configuration (e.g. threads,\n" \
+		L"                  size and scenario). Every metric is reported with its change in percent and the p value of a Welch t-test\n" \
+		L"                  when both files contain several runs (-repeat). The exit code is 1 when a throughput (MB/s) or p99 latency\n" \
+		L"                  metric became significantly (p < 0.05 or not testable) worse than the threshold and 2 when a file could not be read.\n" \
+		L"   -threshold n   Threshold in percent for a regression. Default is 5.\n" \
 		L"  ===== Test Data Generation =====\n" \
-		L"  -createfile dd xxx Create a test data file of dd MB of size. The written data is random and not repeated.\n" \
+		L"  -createfile dd xxx Create a test data file of dd MB of size. The written data is random and not repeated. Every 1 MB chunk is\n" \
+		L"                  generated with a seeded xoshiro256+ PRNG, so the file content does not depend on the number of threads.\n" \
+		L"   -content xx    Content profile: random (default), zero (allocated zero blocks), compressible[:ratio] (1/ratio of every 4 KB\n" \
+		L"                  block is random, the rest zeros, default ratio 2) or sparse[:datapercent] (only datapercent of the 1 MB\n" \
+		L"                  chunks are written, the others are holes, default 50).\n" \
+		L"   -createthreads n  Generate and write the file from n threads (n=all for all cores). Default is all cores.\n" \
 		L"\n" \
 		L"Allocate dd MB of memory and touch the memory pages several times to measure the cost of soft page faults.\n" \
 		L"Additionally you can read a large file from disk as memory mapped file from 1 or more threads several times to measure the\n" \
 		L"impact of file mapping induced soft and hard page faults\n" \
+		L"All parallel tests run on persistent worker threads which start at the same time. Time_ms is the time from the first thread start\n" \
+		L"until the last thread has finished. StartSkew_us and EndSkew_us show how far apart the threads started and finished.\n" \
 		L"Examples\n" \
 		L"Allocate 2 GB of memory and access the first byte of every page (4096 bytes) from 1 up to as many threads as the CPU has cores.\n" \
 		L"  FastPageFault -N 2000 -touchthreads all\n" \
@@ -61,74 +169,316 @@ void Program::Help()
 	}
 	for (auto error : _Errors)
 	{
-		wprintf(error.c_str());
+		wprintf(L"%ls", error.c_str());
 	}
 }
 
 
-void Program::Execute()
+// Returns the exit code of the process which is not 0 when -compare found a regression
+int Program::Execute()
+{
+	if (_bTsc && !Stopwatch::UseTsc(true))
+	{
+		_Results.Message(L"Warning: The CPU has no invariant TSC. Falling back to the steady clock.");
+	}
+
+	if (_bPerfCounters && !PerfCounters().IsAvailable())
+	{
+		_Results.Message(L"Warning: perf_event_open is not available (perf_event_paranoid, container or OS). All counters are reported as N.a.");
+	}
+
+	if (_Action == Action::Compare)
+	{
+		int regressions = _Results.Compare(_BaselineFile, _FileName, _ThresholdPercent);
+		_Results.Flush();
+		return regressions == 0 ? 0 : (regressions < 0 ? 2 : 1);
+	}
+
+	AddMetadata();
+	_Results.SetSaveFile(_SaveFile);
+
+	// Creating the test file is no measurement
+	int warmup = _Action == Action::CreateFile ? 0 : _Warmup;
+	int repeat = _Action == Action::CreateFile ? 1 : _Repeat;
+	_Results.SetRuns(repeat, _bRejectOutliers);
+
+	for (int run = -warmup; run < repeat; run++)
+	{
+		_Results.BeginRun(run < 0);
+		if (warmup > 0 || repeat > 1)
+		{
+			_Results.Message(run < 0 ? StringExtensions::Format(L"Warmup %d of %d", run + warmup + 1, warmup) : StringExtensions::Format(L"Run %d of %d", run + 1, repeat));
+		}
+
+		if (_ProcessCount > 0)
+		{
+			ProcessTest();
+			continue;
+		}
+
+		switch (_Action)
+		{
+		case Action::CreateFile:
+			CreateTestFile();
+			break;
+		case Action::Memory:
+			AllocateTest();
+			break;
+		case Action::FileMap:
+			FileMappingTest();
+			break;
+		case Action::MemCpy:
+			MemCopyTest();
+			break;
+		case Action::Prefault:
+			PrefaultTest();
+			break;
+		case Action::Ingest:
+			IngestTest();
+			break;
+		case Action::Bandwidth:
+			BandwidthTest();
+			break;
+		case Action::Allocators:
+			AllocatorTest();
+			break;
+		case Action::Sweep:
+			SweepTest();
+			break;
+		default:
+			wprintf(L"Invalid Execution Action: %d\n", _Action);
+		}
+	}
+
+	_Results.EndRuns();
+	_Results.Flush();
+	return 0;
+}
+
+// Everything which is needed to compare runs from different machines. Written in front of every Csv row and into the Json document.
+void Program::AddMetadata()
 {
-	switch (_Action)
+	std::wstring layout;
+	auto &topology = Numa::GetTopology();
+	for (auto &node : topology)
 	{
-	case Action::CreateFile:
-		CreateTestFile();
-		break;
-	case Action::Memory:
-		AllocateTest();
-		break;
-	case Action::FileMap:
-		FileMappingTest();
-		break;
-	case Action::MemCpy:
-		MemCopyTest();
-		break;
-	default:
-		wprintf(L"Invalid Execution Action: %d\n", _Action);
+		layout += StringExtensions::Format(L"%ls%d:%zu", layout.empty() ? L"" : L" ", node.Id, node.Cpus.size());
 	}
+
+	_Results.AddMetadata(L"Host", Platform::GetHostName());
+	_Results.AddMetadata(L"CPU", Platform::GetCpuModel());
+	_Results.AddMetadata(L"Cores", std::to_wstring(std::thread::hardware_concurrency()));
+	_Results.AddMetadata(L"OS", Platform::GetOsVersion());
+	_Results.AddMetadata(L"PageSize", std::to_wstring(Platform::GetPageSize()));
+	_Results.AddMetadata(L"BufferPageSize", std::to_wstring(_PageBytes));
+	_Results.AddMetadata(L"THP", Platform::GetTransparentHugePageMode());
+	_Results.AddMetadata(L"NumaNodes", std::to_wstring(topology.size()));
+	_Results.AddMetadata(L"NumaLayout", layout); // node:cpus
+	_Results.AddMetadata(L"Clock", Stopwatch::IsTsc() ? L"tsc" : L"steady_clock");
+	_Results.AddMetadata(L"Arguments", _CommandLine);
 }
 void Program::AllocateTest()
 {
-	std::vector<std::thread> mapThreads;
+	Interference interference;
 
-	// Execute concurrently a file mapping operation which will map the entire file 
-	// and touch all mapped pages as soft or hard faults depending on the settings
-	// This is done in a loop until the main thread has finished soft faulting all of its pages via the _bFinishTouching flag
-	// to ensure that we measure the file map/touch/unmap overhead for the complete duration while we are soft faulting memory pages
+	// Execute concurrently the background activities like the file mapping operation (-file) which will map the entire file
+	// and touch all mapped pages as soft or hard faults depending on the settings.
+	// This is done in a loop until the touch threads have finished soft faulting all of their pages
+	// to ensure that we measure the interference for the complete duration while we are soft faulting memory pages
 	// into our working set
-	if (!_FileName.empty())
+	interference.Start(_Activities);
+	std::this_thread::sleep_for(std::chrono::milliseconds(10)); // Give the threads some time to start
+
+	bool bSustained = _DurationSeconds > 0 || _Iterations > 0;
+	if (bSustained)
+	{
+		SustainedTest();
+	}
+	else
 	{
-		for (int i = 0; i < _MapThreadCount; i++)
+		AllocateAndTouchMemory(_BytesToAllocate);
+	}
+
+	interference.Stop(); // stop the background activities when we have finished measuring the soft page fault performance
+	ReportInterferenceErrors(interference, _Activities);
+
+	if (!_Activities.empty() && !bSustained)
+	{
+		InterferenceTest();
+	}
+}
+
+void Program::ReportInterferenceErrors(const Interference &interference, const std::vector<Interference::Activity> &activities)
+{
+	for (size_t i = 0; i < activities.size(); i++)
+	{
+		if (interference.GetErrors(i) > 0)
 		{
-			mapThreads.push_back(std::thread([=]()
-			{
-				while (!_bFinishTouching)
-				{
-					MemoryMappedFile file(_FileName, _bFlushFileSystemCache);
-					Stopwatch dummy;
-					file.TouchPages(dummy);
-				}
-			}));
+			_Results.Message(StringExtensions::Format(L"Warning: %llu operations of the activity %ls failed and were retried",
+				(unsigned long long)interference.GetErrors(i), Interference::ToString(activities[i]).c_str()));
+		}
+		if (interference.GetCachedMaps(i) > 0)
+		{
+			_Results.Message(StringExtensions::Format(L"Warning: %llu operations of the activity %ls read a file which could not be evicted from the file system cache",
+				(unsigned long long)interference.GetCachedMaps(i), Interference::ToString(activities[i]).c_str()));
 		}
 	}
+}
+
+// Allocate, touch and free the -N buffer with all touch threads in a loop until -duration or -iterations is reached and print
+// one sample per -interval. The samples show the warm up, the steady state and a degradation over time e.g. when the
+// physical memory becomes fragmented. MB/s includes the allocation and release, us/Page and the percentiles only the touch.
+void Program::SustainedTest()
+{
+	const size_t N = _BytesToAllocate;
+	auto phases = GetAccessPhases();
+	WorkerPool pool(_TouchThreads, [=](int i) { return PinWorkerThread(i); });
+
+	PrintPageSize();
+	_Results.BeginTable(L"sustained", L"Time_s\tIterations\tMB/s\tus/Page\tp50_us\tp99_us\tp99.9_us\tmax_us\tRSS_MB\tPageFaults");
+
+	Platform::MemoryCounters lastCounters;
+	Platform::GetMemoryCounters(lastCounters);
+	std::vector<Histogram> histograms(_TouchThreads);
+	std::chrono::nanoseconds touchTime(0);
+	int64_t iterations = 0, intervalIterations = 0;
+	size_t intervalBytes = 0;
+
+	Stopwatch total;
+	Stopwatch interval;
+	while ((_DurationSeconds == 0 || Stopwatch::ToSeconds(total.Stop()) < _DurationSeconds) && (_Iterations == 0 || iterations < _Iterations))
+	{
+		void *pBuffer = VirtualAlloc(N);
+		if (pBuffer == nullptr)
+		{
+			return;
+		}
 
-	::Sleep(10); // Give the threads some time to start
+		_Pattern.Prepare(N, GetTouchStride(), _TouchThreads);
+		for (auto &phase : phases)
+		{
+			pool.Run(_TouchThreads, [&](int i) { _Pattern.Touch(pBuffer, i, phase.Access, &histograms[i]); });
+			touchTime += pool.GetWallTime();
+			intervalBytes += N;
+		}
 
-	AllocateAndTouchMemory(_BytesToAllocate);
+		VirtualFree(pBuffer, N);
+		iterations++;
+		intervalIterations++;
 
-	_bFinishTouching = true; // stop file map/touch/unmap cycle when we have finished measuring the soft page fault performance
-	// wait for running reader threads
-	for (auto &t : mapThreads)
+		// the last sample is printed also when it is shorter than the interval
+		auto elapsed = interval.Stop();
+		bool bLast = (_DurationSeconds > 0 && Stopwatch::ToSeconds(total.Stop()) >= _DurationSeconds) || (_Iterations > 0 && iterations >= _Iterations);
+		if (elapsed < std::chrono::milliseconds(_IntervalMs) && !bLast)
+		{
+			continue;
+		}
+
+		Histogram merged;
+		for (auto &histogram : histograms)
+		{
+			merged.Merge(histogram);
+		}
+
+		Platform::MemoryCounters counters;
+		Platform::GetMemoryCounters(counters);
+
+		auto us = [](uint64_t ticks) { return TickCounter::ToNs(ticks) / 1000.0; };
+		_Results.AddRow(StringExtensions::Format(L"%.3f\t%lld\t%.0f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.1f\t%llu", Stopwatch::ToSeconds(total.Stop()), (long long)intervalIterations,
+			MBPerSecond(intervalBytes, elapsed), AveragePageAccessTimeInus(touchTime, intervalBytes, _PageBytes),
+			us(merged.GetValueAtPercentile(50)), us(merged.GetValueAtPercentile(99)), us(merged.GetValueAtPercentile(99.9)), us(merged.GetMax()),
+			counters.WorkingSetBytes / (1024.0 * 1024.0), (unsigned long long)(counters.PageFaults - lastCounters.PageFaults)));
+		fflush(stdout); // show the samples while the test is running also when the output is redirected
+
+		histograms.assign(_TouchThreads, Histogram());
+		lastCounters = counters;
+		touchTime = std::chrono::nanoseconds(0);
+		intervalIterations = 0;
+		intervalBytes = 0;
+		interval.Start();
+	}
+}
+
+// Measure Touch 1 with all touch threads without interference, with every background activity alone and with all
+// activities together. The inflation is the time and p99 page fault latency relative to the run without interference.
+void Program::InterferenceTest()
+{
+	WorkerPool pool(_TouchThreads, [=](int i) { return PinWorkerThread(i); });
+	Interference interference;
+	const size_t N = _BytesToAllocate;
+	const PageAccess access = GetAccessPhases()[0].Access;
+
+	std::chrono::nanoseconds baseTime(0);
+	uint64_t baseP99 = 0;
+	auto measure = [&](const wchar_t *name, const std::vector<Interference::Activity> &activities)
 	{
-		t.join();
+		void *pBuffer = VirtualAlloc(N);
+		if (pBuffer == nullptr)
+		{
+			return;
+		}
+
+		std::vector<Histogram> histograms(_TouchThreads);
+		_Pattern.Prepare(N, GetTouchStride(), _TouchThreads);
+
+		interference.Start(activities);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		pool.Run(_TouchThreads, [&](int i) { _Pattern.Touch(pBuffer, i, access, &histograms[i]); });
+		interference.Stop();
+		ReportInterferenceErrors(interference, activities);
+
+		Histogram merged;
+		for (auto &histogram : histograms)
+		{
+			merged.Merge(histogram);
+		}
+		auto ns = pool.GetWallTime();
+		uint64_t p99 = merged.GetValueAtPercentile(99);
+		if (activities.empty())
+		{
+			baseTime = ns;
+			baseP99 = p99;
+		}
+
+		uint64_t operations = 0;
+		for (size_t i = 0; i < activities.size(); i++)
+		{
+			operations += interference.GetOperations(i);
+		}
+
+		auto us = [](uint64_t ticks) { return TickCounter::ToNs(ticks) / 1000.0; };
+		_Results.AddRow(StringExtensions::Format(L"%ls\t%d\t%.0f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.2f\t%.2f", name, _TouchThreads,
+			activities.empty() ? 0.0 : operations / Stopwatch::ToSeconds(interference.GetRunTime()), Stopwatch::ToMs(ns), AveragePageAccessTimeInus(ns, N, _PageBytes),
+			us(merged.GetValueAtPercentile(50)), us(p99), us(merged.GetMax()),
+			baseTime.count() == 0 ? 0.0 : (double)ns.count() / baseTime.count(), baseP99 == 0 ? 0.0 : (double)p99 / baseP99));
+
+		VirtualFree(pBuffer, N);
+	};
+
+	_Results.BeginTable(L"interference", L"Interference\tThreads\tOps/s\tTime_ms\tus/Page\tp50_us\tp99_us\tmax_us\tInflation\tp99_Inflation", L"Interference\tThreads");
+	measure(L"none", std::vector<Interference::Activity>());
+	for (auto &activity : _Activities)
+	{
+		measure(Interference::ToString(activity).c_str(), std::vector<Interference::Activity>{ activity });
+	}
+	if (_Activities.size() > 1)
+	{
+		measure(L"all", _Activities);
 	}
 }
 
 void Program::AllocateAndTouchMemory(size_t N)
 {
-	Stopwatch sw;
-	sw.Start();
+	PrintPageSize();
+	_Results.BeginTable(L"touch", StringExtensions::Format(L"Threads\tSize_MB\tTime_ms\tus/Page\tMB/s\tScenario\tStartSkew_us\tEndSkew_us%ls", GetPerfHeader()), L"Threads\tSize_MB\tScenario");
+
+	// thread count, scenario and merged histogram of every measured pass
+	std::vector<std::tuple<int, std::wstring, Histogram>> latencies;
+	auto phases = GetAccessPhases();
 
-	wprintf(L"Threads\tSize_MB\tTime_ms\tus/Page\tMB/s\tScenario\n");
+	// The touch threads are created and pinned once. Thread creation is not part of the measured time
+	// and all threads start touching at the same time.
+	WorkerPool pool(_TouchThreads, [=](int i) { return PinWorkerThread(i); });
 
 	for (int nTouch = 1; nTouch <= _TouchThreads; nTouch++)
 	{
@@ -142,40 +492,95 @@ void Program::AllocateAndTouchMemory(size_t N)
 		{
 			LockMemory(pBuffer, N);
 		}
-		auto AllocTime = sw.Stop();
 
-		sw.Start();
-		// The overhead to create a new thread and get it running is normally
-		// well below 1ms. We can do this also in the single threaded case without loosing accuracy.
-		std::vector<std::thread> touchThreads;
-		__int64 bytesPerThread = _BytesToAllocate / nTouch;
+		// distribute the pages over the threads before the measurement starts. No page is touched by two threads.
+		_Pattern.Prepare(N, GetTouchStride(), nTouch);
+		float MB = (float)(N / (1024LL * 1024));
 
-		for (int i = 0; i < nTouch; i++)
+		// ReadThenWrite measures the zero page mapping of the read pass and the copy on write fault of the following write pass separately
+		for (auto &phase : phases)
 		{
-			touchThreads.push_back(std::thread([=]
+			std::wstring scenario = StringExtensions::Format(L"Touch 1 %ls", phase.Name);
+
+			// every thread records into its own histogram which is merged after all threads have finished
+			std::vector<std::unique_ptr<Histogram>> histograms;
+			for (int i = 0; _bHistogram && i < nTouch; i++)
 			{
-				Touch(((int *)pBuffer) + i* bytesPerThread / 4, bytesPerThread);
+				histograms.push_back(std::unique_ptr<Histogram>(new Histogram()));
 			}
-			));
-		}
+			std::vector<PerfCounterValues> counters(nTouch);
 
-		for (auto &t : touchThreads)
-		{
-			t.join();
+			pool.Run(nTouch, [&](int i)
+			{
+				PerfCounterScope perf(_bPerfCounters ? &counters[i] : nullptr);
+				_Pattern.Touch(pBuffer, i, phase.Access, _bHistogram ? histograms[i].get() : nullptr);
+			});
+
+			auto touchTime = pool.GetWallTime();
+			if (IsNumaActive())
+			{
+				auto results = GetThreadResults(pool, nTouch, 0);
+				for (int i = 0; i < nTouch; i++)
+				{
+					std::vector<void *> pages;
+					for (size_t offset : _Pattern.GetSampleOffsets(i, 1024))
+					{
+						pages.push_back((char *)pBuffer + offset);
+					}
+					results[i].Bytes = _Pattern.GetThreadBytes(i);
+					results[i].LocalFraction = Numa::GetLocalFraction(pages, results[i].Node);
+				}
+
+				// the earlier passes of -access are repeated untimed so that the measured pass causes the same fault type
+				size_t phaseIndex = &phase - &phases[0];
+				std::vector<AccessPattern> slices(nTouch);
+				MeasureLocalRemote(pool, results, 1, [&](int i, char **ppBuffers)
+				{
+					slices[i].Prepare(results[i].Bytes, GetTouchStride(), 1);
+					for (size_t p = 0; p < phaseIndex; p++)
+					{
+						slices[i].Touch(ppBuffers[0], 0, phases[p].Access, nullptr);
+					}
+				},
+				[&](int i, char **ppBuffers) { slices[i].Touch(ppBuffers[0], 0, phase.Access, nullptr); });
+				AddNodeRows(nTouch, scenario.c_str(), results);
+			}
+			_Results.AddRow(StringExtensions::Format(L"%d\t%.0f\t%.3f\t%.3f\t%.0f\t%ls%ls%ls", nTouch, MB, Stopwatch::ToMs(touchTime), AveragePageAccessTimeInus(touchTime, N, _PageBytes), MBPerSecond(N, touchTime),
+				scenario.c_str(), FormatSkew(pool).c_str(), FormatPerf(counters).c_str()));
+
+			if (_bHistogram)
+			{
+				Histogram merged;
+				for (auto &histogram : histograms)
+				{
+					merged.Merge(*histogram);
+				}
+				latencies.push_back(std::make_tuple(nTouch, scenario, merged));
+			}
 		}
 
-		auto touchTime = sw.Stop();
-		float MB = (float)(N / (1024LL * 1024));
-		float s = (float)touchTime.count() / 1000.0f;
-		printf("%d\t%.0f\t%lld\t%.3f\t%.0f\tTouch 1\n", nTouch, MB, touchTime.count(), AveragePageAccessTimeInus(touchTime, N), MB / s);
+		std::vector<PerfCounterValues> counters2(1);
+		pool.Run(1, [&](int)
+		{
+			PerfCounterScope perf(_bPerfCounters ? &counters2[0] : nullptr);
+			Touch(pBuffer, N);
+		});
+		auto touchTime2 = pool.GetWallTime();
+		_Results.AddRow(StringExtensions::Format(L"%d\t%.0f\t%.3f\t%.3f\tN.a.\tTouch 2%ls%ls", nTouch, MB, Stopwatch::ToMs(touchTime2), AveragePageAccessTimeInus(touchTime2, N, _PageBytes),
+			FormatSkew(pool).c_str(), FormatPerf(counters2).c_str()));
+		VirtualFree(pBuffer, N);
+	}
 
-		sw.Start();
-		Touch(pBuffer, N);
-		auto touchTime2 = sw.Stop();
-		printf("%d\t%.0f\t%lld\t%.3f\tN.a.\tTouch 2\n", nTouch, MB, touchTime2.count(), AveragePageAccessTimeInus(touchTime2, N));
-		//VirtualFree(pBuffer);
+	if (_bHistogram)
+	{
+		PrintLatencyHeader();
+		for (auto &latency : latencies)
+		{
+			PrintLatency(std::get<0>(latency), std::get<2>(latency), std::get<1>(latency).c_str());
+		}
 	}
 
+	PrintNodeRows();
 }
 
 // Touch is from the compiler point of view a nop operation with no observable side effect 
@@ -184,147 +589,958 @@ void Program::AllocateAndTouchMemory(size_t N)
 #pragma optimize( "", off )
 void Program::Touch(void *p, size_t N)
 {
-	char *pB = (char *)p;
-	char tmp;
-	for (size_t i = 0; i < N; i += 4096)
+	volatile char *pB = (char *)p;
+	const size_t stride = GetTouchStride();
+	for (size_t i = 0; i < N; i += stride)
+	{
+		(void)pB[i];
+	}
+
+}
+
+// Write to every page which is the first real access of an application to freshly allocated memory
+void Program::TouchWrite(void *p, size_t N)
+{
+	AccessPattern::TouchWrite(p, N, GetTouchStride());
+}
+#pragma optimize("", on)
+
+void Program::PrintLatencyHeader()
+{
+	_Results.BeginTable(L"latency", L"Threads\tPages\tp50_us\tp90_us\tp99_us\tp99.9_us\tmax_us\tScenario", L"Threads\tPages\tScenario");
+}
+
+const wchar_t *Program::GetPerfHeader()
+{
+	return _bPerfCounters ? PerfCounterValues::GetHeader() : L"";
+}
+
+// Sum the counters of all threads which took part in the measurement
+std::wstring Program::FormatPerf(const std::vector<PerfCounterValues> &perThread)
+{
+	if (!_bPerfCounters)
+	{
+		return L"";
+	}
+
+	PerfCounterValues sum;
+	for (auto &values : perThread)
+	{
+		sum.Add(values);
+	}
+	return sum.Format();
+}
+
+void Program::PrintLatency(int threads, const Histogram &histogram, const wchar_t *scenario)
+{
+	auto us = [](uint64_t ticks) { return TickCounter::ToNs(ticks) / 1000.0; };
+	_Results.AddRow(StringExtensions::Format(L"%d\t%llu\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%ls", threads, (unsigned long long) histogram.GetCount(),
+		us(histogram.GetValueAtPercentile(50)), us(histogram.GetValueAtPercentile(90)), us(histogram.GetValueAtPercentile(99)),
+		us(histogram.GetValueAtPercentile(99.9)), us(histogram.GetMax()), scenario));
+}
+
+// Copy memory from a source to a destination buffer where the source buffer is fully initialized and zeroed. 
+// The destination buffer is not yet touched and the first time subject to soft page faults.
+// To speed up the sequential memcpy we use 1-nThread threads to copy from each thread a portion of the array to the destination
+// to measure the cost of concurrent page faults along with concurrent memcpy.
+// This will increase the soft page fault time due to internal locks in the page fault implementation while the added concurrency will 
+// reduce the overall memcpy time.
+// On the second run we will effectively measure the memory bandwidth with this test.
+// Every -kernels copy loop gets a new destination buffer. Fault_% is the part of the Touch_1 time which the Touch_2 copy did not need.
+void Program::MemCopyTest()
+{
+	std::vector<CopyKernel::Kind> kernels = _CopyKernels.empty() ? std::vector<CopyKernel::Kind>{ CopyKernel::Kind::Memcpy } : _CopyKernels;
+	std::vector<std::wstring> kernelRows;
+
+	PrintPageSize();
+	_Results.BeginTable(L"memcopy", StringExtensions::Format(L"Threads\tSize_MB\tKernel\tTime_ms\tus/Page\tMB/s\tScenario\tStartSkew_us\tEndSkew_us%ls", GetPerfHeader()), L"Threads\tSize_MB\tKernel\tScenario");
+
+	float maxMBs[2] = {};
+	WorkerPool pool(_MemCopyThreads, [=](int i) { return PinWorkerThread(i); });
+
+	for (int nThread = 1; nThread <= _MemCopyThreads; nThread++)
+	{
+		void *pSource = VirtualAlloc(_BytesToMemCopy);
+		if (pSource == nullptr)
+		{
+			return;
+		}
+
+		memset(pSource, 0, _BytesToMemCopy);
+		auto MB = _BytesToMemCopy / (1024LL * 1024LL);
+
+		for (auto kernel : kernels)
+		{
+			void *pDest = VirtualAlloc(_BytesToMemCopy);
+			if (pDest == nullptr)
+			{
+				VirtualFree(pSource, _BytesToMemCopy);
+				return;
+			}
+
+			CopyKernel::CopyFunction copy = CopyKernel::Get(kernel);
+			float touchMBs[2] = {};
+			for (int run = 0; run < 2; run++)
+			{
+				std::vector<PerfCounterValues> counters(nThread);
+				int64_t sizePerThread = (_BytesToMemCopy / nThread) / _PageBytes * _PageBytes;
+
+				// the last thread also copies the pages which are left over by the page aligned split
+				auto threadSize = [&](int i) { return i == nThread - 1 ? _BytesToMemCopy - i * sizePerThread : sizePerThread; };
+
+				pool.Run(nThread, [&](int i)
+				{
+					PerfCounterScope perf(_bPerfCounters ? &counters[i] : nullptr);
+					copy(((unsigned char *)pDest) + i*sizePerThread, ((unsigned char *)pSource) + i*sizePerThread, threadSize(i));
+				});
+
+				auto ns = pool.GetWallTime();
+				if (IsNumaActive())
+				{
+					auto results = GetThreadResults(pool, nThread, sizePerThread);
+					for (int i = 0; i < nThread; i++)
+					{
+						results[i].Bytes = threadSize(i);
+						results[i].LocalFraction = Numa::GetLocalFraction(((char *)pDest) + i * sizePerThread, threadSize(i), results[i].Node);
+					}
+
+					// buffer 0 is the source, buffer 1 the destination which is only resident for Touch_2
+					MeasureLocalRemote(pool, results, 2, [&](int i, char **ppBuffers)
+					{
+						memset(ppBuffers[0], 0, results[i].Bytes);
+						if (run == 1)
+						{
+							memset(ppBuffers[1], 0, results[i].Bytes);
+						}
+					},
+					[&](int i, char **ppBuffers) { copy(ppBuffers[1], ppBuffers[0], results[i].Bytes); });
+					AddNodeRows(nThread, StringExtensions::Format(L"Touch_%d %ls", run + 1, CopyKernel::ToString(kernel)).c_str(), results);
+				}
+				float MBs = MBPerSecond(_BytesToMemCopy, ns);
+				_Results.AddRow(StringExtensions::Format(L"%d\t%lld\t%ls\t%.3f\t%.3f\t%.0f\tTouch_%d%ls%ls", nThread, MB, CopyKernel::ToString(kernel), Stopwatch::ToMs(ns),
+					AveragePageAccessTimeInus(ns, _BytesToMemCopy, _PageBytes), MBs, run + 1, FormatSkew(pool).c_str(), FormatPerf(counters).c_str()));
+				maxMBs[run] = (std::max)(maxMBs[run], MBs);
+				touchMBs[run] = MBs;
+			}
+
+			kernelRows.push_back(StringExtensions::Format(L"%d\t%lld\t%ls\t%.0f\t%.0f\t%.1f", nThread, MB, CopyKernel::ToString(kernel), touchMBs[0], touchMBs[1],
+				touchMBs[1] == 0 ? 0.0 : 100.0 * (1.0 - touchMBs[0] / touchMBs[1])));
+			VirtualFree(pDest, _BytesToMemCopy);
+		}
+
+		// copy bandwidth of the resident buffers with all threads as reference for the copies which fault the destination
+		void *pDest = nThread == _MemCopyThreads ? VirtualAlloc(_BytesToMemCopy) : nullptr;
+		if (pDest != nullptr)
+		{
+			memset(pDest, 0, _BytesToMemCopy);
+			auto ns = MeasureBandwidth(pool, nThread, Bandwidth::Kernel::Copy, (double *)pSource, nullptr, (double *)pDest, _BytesToMemCopy / sizeof(double), 1);
+			float streamMBs = MBPerSecond(2 * _BytesToMemCopy, ns);
+			_Results.Message(StringExtensions::Format(L"Memory bandwidth (STREAM copy with %d threads, read + write): %.0f MB/s. The fastest Touch_1 copy reached %.1f%%, Touch_2 %.1f%% of it.",
+				nThread, streamMBs, streamMBs == 0 ? 0.0 : 200.0 * maxMBs[0] / streamMBs, streamMBs == 0 ? 0.0 : 200.0 * maxMBs[1] / streamMBs));
+			VirtualFree(pDest, _BytesToMemCopy);
+		}
+
+		VirtualFree(pSource, _BytesToMemCopy);
+	}
+
+	if (!_CopyKernels.empty())
+	{
+		_Results.BeginTable(L"memcopykernels", L"Threads\tSize_MB\tKernel\tTouch_1_MB/s\tTouch_2_MB/s\tFault_%", L"Threads\tSize_MB\tKernel");
+		for (auto &row : kernelRows)
+		{
+			_Results.AddRow(row);
+		}
+	}
+
+	PrintNodeRows();
+}
+
+
+// STREAM style bandwidth of resident buffers from the L1 cache up to DRAM. The three arrays have the size of the step and are
+// shared by all threads where every thread works on its contiguous part. Small steps are repeated until about 256 MB were
+// moved per trial to get measurable times.
+void Program::BandwidthTest()
+{
+	const size_t minBytes = 16 * 1024;
+	const size_t trialBytes = 256 * 1024 * 1024;
+	const size_t maxBytes = (std::max)((size_t)_BytesToAllocate, minBytes);
+
+	std::vector<size_t> sizes;
+	for (size_t size = minBytes; size < maxBytes; size *= 4)
+	{
+		sizes.push_back(size);
+	}
+	sizes.push_back(maxBytes);
+
+	double *arrays[3] = {};
+	for (auto &array : arrays)
+	{
+		array = (double *)VirtualAlloc(maxBytes);
+		if (array == nullptr)
+		{
+			for (auto p : arrays)
+			{
+				if (p != nullptr)
+				{
+					VirtualFree(p, maxBytes);
+				}
+			}
+			return;
+		}
+		for (size_t j = 0; j < maxBytes / sizeof(double); j++)
+		{
+			array[j] = 1.0;
+		}
+	}
+
+	PrintPageSize();
+	_Results.BeginTable(L"bandwidth", L"Threads\tSize_KB\tKernel\tIterations\tTime_ms\tMB/s", L"Threads\tSize_KB\tKernel");
+	WorkerPool pool(_BandwidthThreads, [=](int i) { return PinWorkerThread(i); });
+
+	std::wstring dram;
+	for (int nThreads = 1; nThreads <= _BandwidthThreads; nThreads++)
+	{
+		for (size_t size : sizes)
+		{
+			int iterations = (int)(std::max)((size_t)1, trialBytes / size);
+			for (auto kernel : { Bandwidth::Kernel::Read, Bandwidth::Kernel::Write, Bandwidth::Kernel::Copy, Bandwidth::Kernel::Scale, Bandwidth::Kernel::Triad })
+			{
+				size_t elements = size / sizeof(double);
+				auto ns = MeasureBandwidth(pool, nThreads, kernel, arrays[0], arrays[1], arrays[2], elements, iterations);
+				float MBs = MBPerSecond(elements * Bandwidth::BytesPerElement(kernel) * iterations, ns);
+				_Results.AddRow(StringExtensions::Format(L"%d\t%zu\t%ls\t%d\t%.3f\t%.0f", nThreads, size / 1024, Bandwidth::ToString(kernel), iterations, Stopwatch::ToMs(ns), MBs));
+
+				if (nThreads == _BandwidthThreads && size == maxBytes)
+				{
+					dram += StringExtensions::Format(L" %ls %.0f", Bandwidth::ToString(kernel), MBs);
+				}
+			}
+		}
+	}
+
+	_Results.Message(StringExtensions::Format(L"Memory bandwidth of %zu MB with %d threads in MB/s:%ls", maxBytes / (1024 * 1024), _BandwidthThreads, dram.c_str()));
+
+	for (auto array : arrays)
+	{
+		VirtualFree(array, maxBytes);
+	}
+}
+
+// Touch and copy buffers of geometrically growing size with one thread to show how the cost per page changes with the size.
+// Small buffers fit with their page tables into the caches and the TLB. Large ones need more page table pages (PTE_KB)
+// whose walks miss the caches.
+void Program::SweepTest()
+{
+	auto phases = GetAccessPhases();
+	PrintPageSize();
+	_Results.BeginTable(L"sweep", StringExtensions::Format(L"Size_MB\tScenario\tTime_ms\tus/Page\tMB/s\tFaults\tPTE_KB%ls", GetPerfHeader()), L"Size_MB\tScenario");
+
+	for (size_t size : _SweepSizes)
+	{
+		const size_t N = RoundToPageSize(size);
+		int64_t pteBefore = Platform::GetPageTableBytes();
+
+		// measure one pass. The page table growth is taken after the pass while the buffers are still mapped.
+		auto measure = [&](const std::wstring &scenario, std::function<void()> pass)
+		{
+			std::vector<PerfCounterValues> counters(1);
+			Platform::MemoryCounters before, after;
+			Platform::GetMemoryCounters(before);
+			Stopwatch sw;
+			{
+				PerfCounterScope perf(_bPerfCounters ? &counters[0] : nullptr);
+				pass();
+			}
+			auto ns = sw.Stop();
+			Platform::GetMemoryCounters(after);
+
+			int64_t pte = Platform::GetPageTableBytes();
+			std::wstring pteKB = pte < 0 || pteBefore < 0 ? L"N.a." : StringExtensions::Format(L"%lld", (long long)(pte - pteBefore) / 1024);
+			_Results.AddRow(StringExtensions::Format(L"%.3f\t%ls\t%.3f\t%.3f\t%.0f\t%llu\t%ls%ls", N / (1024.0 * 1024.0), scenario.c_str(), Stopwatch::ToMs(ns),
+				AveragePageAccessTimeInus(ns, N, _PageBytes), MBPerSecond(N, ns), (unsigned long long)(after.PageFaults - before.PageFaults), pteKB.c_str(), FormatPerf(counters).c_str()));
+		};
+
+		void *pBuffer = VirtualAlloc(N);
+		if (pBuffer == nullptr)
+		{
+			return;
+		}
+		_Pattern.Prepare(N, GetTouchStride(), 1);
+		for (auto &phase : phases)
+		{
+			measure(StringExtensions::Format(L"Touch 1 %ls", phase.Name), [&]() { _Pattern.Touch(pBuffer, 0, phase.Access, nullptr); });
+		}
+		VirtualFree(pBuffer, N);
+
+		void *pSource = VirtualAlloc(N);
+		void *pDest = pSource == nullptr ? nullptr : VirtualAlloc(N);
+		if (pDest == nullptr)
+		{
+			if (pSource != nullptr)
+			{
+				VirtualFree(pSource, N);
+			}
+			return;
+		}
+		memset(pSource, 0, N);
+		for (int run = 1; run <= 2; run++)
+		{
+			measure(StringExtensions::Format(L"Memcopy Touch_%d", run), [&]() { memcpy(pDest, pSource, N); });
+		}
+		VirtualFree(pSource, N);
+		VirtualFree(pDest, N);
+	}
+}
+
+// The same allocate/write/release workload through every -strategies allocator. The first iteration faults all pages. The later
+// iterations only fault the pages which the strategy gave back to the OS. RSS_MB is the growth of the resident set after the last
+// release which is the price of the reuse.
+void Program::AllocatorTest()
+{
+	std::vector<Allocator::Config> strategies = _Strategies;
+	if (strategies.empty())
+	{
+		for (auto name : { L"mmap", L"arena", L"dontneed", L"free", L"malloc", L"malloc:1024" })
+		{
+			Allocator::Config config;
+			if (Allocator::Parse(name, config) && Allocator::IsSupported(config))
+			{
+				strategies.push_back(config);
+			}
+		}
+	}
+	// glibc cannot enable its dynamic thresholds again once they were set with mallopt
+	std::stable_partition(strategies.begin(), strategies.end(), [](const Allocator::Config &config) { return config.TrimBytes == 0; });
+
+	const size_t N = _BytesToAllocate;
+	const size_t pageSize = Platform::GetPageSize();
+	const size_t blockBytes = (std::max)((_BlockBytes + pageSize - 1) / pageSize * pageSize, pageSize);
+	const int iterations = _Iterations > 0 ? _Iterations : 20;
+
+	// the first iteration faults in all pages and is reported separately from the reuse cost of the following iterations
+	_Results.BeginTable(L"allocators", L"Strategy\tSize_MB\tBlock_KB\tIterations\tFirst_ms\tFirst_Faults\tTime_ms\tus/Iteration\tMB/s\tFaults/Iteration\tRSS_MB",
+		L"Strategy\tSize_MB\tBlock_KB");
+	for (auto &config : strategies)
+	{
+		Platform::MemoryCounters start, first, end;
+		Platform::GetMemoryCounters(start);
+		first = start;
+		bool bFailed = false;
+
+		Allocator allocator(config, N);
+		std::chrono::nanoseconds firstTime(0);
+		Stopwatch sw;
+		for (int i = 0; i < iterations && !bFailed; i++)
+		{
+			for (size_t offset = 0; offset < N; offset += blockBytes)
+			{
+				size_t n = (std::min)(blockBytes, N - offset);
+				void *p = allocator.Allocate(n);
+				if (p == nullptr)
+				{
+					bFailed = true;
+					break;
+				}
+				TouchWrite(p, n);
+			}
+			allocator.Reset();
+
+			if (i == 0)
+			{
+				firstTime = sw.Stop();
+				Platform::GetMemoryCounters(first);
+				sw.Start();
+			}
+		}
+		auto ns = sw.Stop();
+		Platform::GetMemoryCounters(end);
+
+		std::wstring strategy = Allocator::ToString(config);
+		if (bFailed)
+		{
+			_Results.Message(StringExtensions::Format(L"Allocation with strategy %ls failed. Error: %d", strategy.c_str(), Platform::GetLastError()));
+			continue;
+		}
+
+		std::wstring steady = L"N.a.\tN.a.\tN.a.\tN.a.";
+		if (iterations > 1)
+		{
+			steady = StringExtensions::Format(L"%.3f\t%.1f\t%.0f\t%.1f", Stopwatch::ToMs(ns), ns.count() / 1000.0 / (iterations - 1), MBPerSecond(N * (iterations - 1), ns),
+				(double)(end.PageFaults - first.PageFaults) / (iterations - 1));
+		}
+		_Results.AddRow(StringExtensions::Format(L"%ls\t%zu\t%zu\t%d\t%.3f\t%llu\t%ls\t%.1f", strategy.c_str(), N / (1024 * 1024), blockBytes / 1024, iterations,
+			Stopwatch::ToMs(firstTime), (unsigned long long)(first.PageFaults - start.PageFaults), steady.c_str(),
+			((double)end.WorkingSetBytes - (double)start.WorkingSetBytes) / (1024 * 1024)));
+	}
+}
+
+// Best wall time of 3 trials where nThreads threads execute the kernel on their part of the first elements of the arrays.
+// The parts are multiples of 8 elements (one cache line) so no two threads write to the same cache line.
+std::chrono::nanoseconds Program::MeasureBandwidth(WorkerPool &pool, int nThreads, Bandwidth::Kernel kernel, double *a, double *b, double *c, size_t elements, int iterations)
+{
+	std::chrono::nanoseconds best = std::chrono::nanoseconds::max();
+	for (int trial = 0; trial < 3; trial++)
+	{
+		pool.Run(nThreads, [&](int i)
+		{
+			size_t begin = elements * i / nThreads / 8 * 8;
+			size_t end = i == nThreads - 1 ? elements : elements * (i + 1) / nThreads / 8 * 8;
+			Bandwidth::Run(kernel, a, b, c, begin, end, iterations);
+		});
+		best = (std::min)(best, pool.GetWallTime());
+	}
+	return best;
+}
+
+// Same scenarios as with threads but every worker is a separate process with its own address space. This shows how much of the
+// thread scaling is lost to per process locks (mmap_lock) compared to the system wide costs of page allocation and zeroing.
+void Program::ProcessTest()
+{
+	PrintPageSize();
+	_Results.BeginTable(L"processes", StringExtensions::Format(L"Processes\tSize_MB\tTime_ms\tus/Page\tMB/s\tScenario\tStartSkew_us\tEndSkew_us%ls", GetPerfHeader()), L"Processes\tSize_MB\tScenario");
+
+	auto steps = GetProcessSteps();
+	std::vector<std::wstring> processRows;
+	ProcessGroup group;
+
+	for (int nProcesses = 1; nProcesses <= _ProcessCount; nProcesses++)
+	{
+		if (_Action == Action::FileMap && _bFlushFileSystemCache && !CacheState::Evict(_FileName))
+		{
+			_Results.Message(StringExtensions::Format(L"Could not flush the file system cache of %ls. Error: %d", _FileName.c_str(), Platform::GetLastError()));
+		}
+
+		if (!group.Run(nProcesses, [&](int) { return RunProcessSteps(group); }))
+		{
+			_Results.Message(StringExtensions::Format(L"Could not start %d processes. Error: %d", nProcesses, Platform::GetLastError()));
+			return;
+		}
+
+		for (size_t step = 0; step < steps.size(); step++)
+		{
+			size_t bytes = 0;
+			std::vector<PerfCounterValues> counters;
+			for (int i = 0; i < group.GetProcessCount(); i++)
+			{
+				auto &results = group.GetResults(i);
+				if (step >= results.size())
+				{
+					processRows.push_back(StringExtensions::Format(L"%d\t%d\tN.a.\tN.a.\t%ls\tprocess failed", nProcesses, i, steps[step].c_str()));
+					continue;
+				}
+
+				auto &result = results[step];
+				if (result.Error != 0)
+				{
+					processRows.push_back(StringExtensions::Format(L"%d\t%d\tN.a.\tN.a.\t%ls\terror %d", nProcesses, i, steps[step].c_str(), result.Error));
+					continue;
+				}
+
+				auto ns = std::chrono::nanoseconds((int64_t)TickCounter::ToNs(result.End - result.Start));
+				bytes += result.Bytes;
+				counters.push_back(result.Counters);
+				processRows.push_back(StringExtensions::Format(L"%d\t%d\t%.3f\t%.0f\t%ls%ls", nProcesses, i, Stopwatch::ToMs(ns), MBPerSecond(result.Bytes, ns),
+					steps[step].c_str(), FormatPerf(std::vector<PerfCounterValues>{ result.Counters }).c_str()));
+			}
+
+			auto ns = group.GetWallTime(step);
+			float MB = (float)(bytes / (1024.0 * 1024.0));
+			_Results.AddRow(StringExtensions::Format(L"%d\t%.0f\t%.3f\t%.3f\t%.0f\t%ls\t%.3f\t%.3f%ls", nProcesses, MB, Stopwatch::ToMs(ns),
+				bytes == 0 ? 0.0f : AveragePageAccessTimeInus(ns, bytes, _Action == Action::FileMap ? Platform::GetPageSize() : _PageBytes), MBPerSecond(bytes, ns), steps[step].c_str(),
+				group.GetStartSkew(step).count() / 1000.0, group.GetEndSkew(step).count() / 1000.0, FormatPerf(counters).c_str()));
+		}
+	}
+
+	_Results.BeginTable(L"process", StringExtensions::Format(L"Processes\tProcess\tTime_ms\tMB/s\tScenario%ls", GetPerfHeader()), L"Processes\tProcess\tScenario");
+	for (auto &row : processRows)
+	{
+		_Results.AddRow(row);
+	}
+}
+
+// Names of the measured steps of a child process in the order of RunProcessSteps
+std::vector<std::wstring> Program::GetProcessSteps()
+{
+	std::vector<std::wstring> steps;
+	for (auto &phase : GetAccessPhases())
+	{
+		steps.push_back(StringExtensions::Format(_Action == Action::FileMap ? L"FileMap %ls" : L"Touch 1 %ls", phase.Name));
+	}
+
+	if (_Action == Action::Memory)
+	{
+		steps.push_back(L"Touch 2");
+	}
+	else if (_Action == Action::MemCpy)
+	{
+		steps = { L"Touch_1", L"Touch_2" };
+	}
+	return steps;
+}
+
+// Executed in every child process. The child prepares its own buffer or file mapping and passes one barrier per step
+// also when the preparation failed. Nothing is printed because the output buffer of the child is never flushed.
+std::vector<ProcessGroup::Result> Program::RunProcessSteps(ProcessGroup &group)
+{
+	std::vector<ProcessGroup::Result> results;
+	auto steps = GetProcessSteps();
+	int error = 0;
+
+	auto measure = [&](size_t bytes, std::function<void()> step)
+	{
+		ProcessGroup::Result result;
+		group.Barrier();
+		if (error != 0)
+		{
+			result.Error = error;
+		}
+		else
+		{
+			PerfCounterScope perf(_bPerfCounters ? &result.Counters : nullptr);
+			result.Start = TickCounter::Now();
+			step();
+			result.End = TickCounter::Now();
+			result.Bytes = bytes;
+		}
+		results.push_back(result);
+	};
+
+	if (_Action == Action::Memory)
+	{
+		const size_t N = _BytesToAllocate;
+		void *p = Numa::Allocate(N, _PageSize, _NumaPolicy, _NumaBindNode);
+		error = p == nullptr ? Platform::GetLastError() : 0;
+		_Pattern.Prepare(N, GetTouchStride(), 1);
+		for (auto &phase : GetAccessPhases())
+		{
+			measure(N, [&]() { _Pattern.Touch(p, 0, phase.Access, nullptr); });
+		}
+		measure(N, [&]() { Touch(p, N); });
+	}
+	else if (_Action == Action::MemCpy)
+	{
+		const size_t N = _BytesToMemCopy;
+		void *pSource = Numa::Allocate(N, _PageSize, _NumaPolicy, _NumaBindNode);
+		void *pDest = Numa::Allocate(N, _PageSize, _NumaPolicy, _NumaBindNode);
+		error = pSource == nullptr || pDest == nullptr ? Platform::GetLastError() : 0;
+		if (error == 0)
+		{
+			memset(pSource, 0, N);
+		}
+		for (int run = 0; run < 2; run++)
+		{
+			measure(N, [&]() { memcpy(pDest, pSource, N); });
+		}
+	}
+	else
+	{
+		std::unique_ptr<MemoryMappedFile> pMem;
+		try
+		{
+			pMem.reset(new MemoryMappedFile(_FileName, false, _Access != AccessMode::Read));
+			_Pattern.Prepare(pMem->GetFileSize(), Platform::GetPageSize(), 1);
+		}
+		catch (std::exception &)
+		{
+			error = Platform::GetLastError();
+			error = error == 0 ? -1 : error;
+		}
+
+		for (auto &phase : GetAccessPhases())
+		{
+			measure(pMem ? pMem->GetFileSize() : 0, [&]()
+			{
+				Stopwatch sw;
+				pMem->TouchPages(sw, false, 0, nullptr, nullptr, &_Pattern, phase.Access);
+			});
+		}
+	}
+
+	return results;
+}
+
+// Compare the different ways to get a buffer fully resident before it is used.
+// For every strategy a fresh buffer is allocated. Resident_ms is the time until the allocation and pre-faulting call returns,
+// FirstAccess_ms is the time of the following first write to every page which should be cheap when the pre-faulting worked.
+void Program::PrefaultTest()
+{
+	PrintPageSize();
+	_Results.BeginTable(L"prefault", L"Strategy\tThreads\tSize_MB\tResident_ms\tResident_%\tFirstAccess_ms\tTotal_ms\tus/Page", L"Strategy\tThreads\tSize_MB");
+
+	MeasurePrefault(L"none", 1, [=](size_t n) { return VirtualAlloc(n); });
+
+	MeasurePrefault(L"map_populate", 1, [=](size_t n) { return Numa::AllocatePopulated(n, _PageSize, _NumaPolicy, _NumaBindNode); });
+
+	MeasurePrefault(L"populate_read", 1, [=](size_t n) -> void *
+	{
+		void *p = VirtualAlloc(n);
+		if (p != nullptr && !Platform::Populate(p, n, false))
+		{
+			VirtualFree(p, n);
+			return nullptr;
+		}
+		return p;
+	});
+
+	MeasurePrefault(L"populate_write", 1, [=](size_t n) -> void *
+	{
+		void *p = VirtualAlloc(n);
+		if (p != nullptr && !Platform::Populate(p, n, true))
+		{
+			VirtualFree(p, n);
+			return nullptr;
+		}
+		return p;
+	});
+
+	Platform::GrowLockLimit(_BytesToAllocate, _BytesToAllocate + 500uLL * 1024 * 1024);
+	MeasurePrefault(L"mlock", 1, [=](size_t n) -> void *
+	{
+		void *p = VirtualAlloc(n);
+		if (p != nullptr && !Platform::Lock(p, n))
+		{
+			VirtualFree(p, n);
+			return nullptr;
+		}
+		return p;
+	});
+
+	WorkerPool pool(_TouchThreads, [=](int i) { return PinWorkerThread(i); });
+	for (int nThreads = 1; nThreads <= _TouchThreads; nThreads++)
+	{
+		MeasurePrefault(L"pretouch", nThreads, [=, &pool](size_t n) -> void *
+		{
+			void *p = VirtualAlloc(n);
+			if (p == nullptr)
+			{
+				return nullptr;
+			}
+
+			size_t bytesPerThread = (n / nThreads) / _PageBytes * _PageBytes;
+			pool.Run(nThreads, [&](int i)
+			{
+				size_t size = i == nThreads - 1 ? n - i * bytesPerThread : bytesPerThread;
+				TouchWrite((char *)p + i * bytesPerThread, size);
+			});
+			return p;
+		});
+	}
+}
+
+void Program::MeasurePrefault(const wchar_t *strategy, int threads, std::function<void *(size_t n)> allocateResident)
+{
+	const size_t N = _BytesToAllocate;
+	const int64_t MB = N / (1024LL * 1024LL);
+
+	Stopwatch sw;
+	void *p = allocateResident(N);
+	auto residentTime = sw.Stop();
+	if (p == nullptr)
+	{
+		_Results.AddRow(StringExtensions::Format(L"%ls\t%d\t%lld\tN.a.\tN.a.\tN.a.\tN.a.\tN.a.\tnot supported, error %d", strategy, threads, MB, Platform::GetLastError()));
+		return;
+	}
+
+	double resident = Platform::GetResidentFraction(p, N);
+
+	sw.Start();
+	TouchWrite(p, N);
+	auto firstAccessTime = sw.Stop();
+
+	auto total = residentTime + firstAccessTime;
+	_Results.AddRow(StringExtensions::Format(L"%ls\t%d\t%lld\t%.3f\t%.1f\t%.3f\t%.3f\t%.3f", strategy, threads, MB, Stopwatch::ToMs(residentTime), resident * 100.0,
+		Stopwatch::ToMs(firstAccessTime), Stopwatch::ToMs(total), AveragePageAccessTimeInus(total, N, _PageBytes)));
+
+	VirtualFree(p, N);
+}
+
+/// Create test file with the -content profile from -createthreads threads
+void Program::CreateTestFile()
+{
+	Stopwatch sw;
+	sw.Start();
+	int error = TestData::Create(_FileName, _BytesToAllocate, _TestData);
+	auto ns = sw.Stop();
+
+	if (error != 0)
+	{
+		_Results.Message(StringExtensions::Format(L"Error: Could not write to file %ls, LastError: %d", _FileName.c_str(), error));
+		return;
+	}
+
+	_Results.Message(StringExtensions::Format(L"Created file %ls of size %lld MB with %ls content from %d threads in %.0f ms, %.0f MB/s", _FileName.c_str(),
+		_BytesToAllocate / (1024LL * 1024LL), TestData::ToString(_TestData).c_str(), _TestData.Threads, Stopwatch::ToMs(ns), MBPerSecond(_BytesToAllocate, ns)));
+}
+
+///
+// Map and touch the file once for every -advice. Cached_% is the part of the file in the file system cache before it is mapped.
+// Map_ms contains the read of the whole file for populate, Prefetch_ms the time until a willneed (or -prefetch) read ahead has
+// completed and Resident_% how much of the file was in memory before the first touch. Faults and HardFaults are the page faults of the touch.
+void Program::FileMappingTest()
+{
+	auto phases = GetAccessPhases();
+	std::vector<Platform::MapAdvice> advices = _Advices.empty() ? std::vector<Platform::MapAdvice>{ Platform::MapAdvice::Normal } : _Advices;
+	std::vector<std::vector<Histogram>> histograms(advices.size(), std::vector<Histogram>(phases.size()));
+	PrintPageSize();
+
+	_Results.BeginTable(L"filemap", StringExtensions::Format(L"File\tSize_MB\tAdvice\tCached_%%\tMap_ms\tPrefetch_ms\tResident_%%\tTime_ms\tus/Page\tMB/s\tFaults\tHardFaults\tScenario%ls", GetPerfHeader()),
+		L"File\tSize_MB\tAdvice\tScenario");
+	for (size_t a = 0; a < advices.size(); a++)
+	{
+		PrepareCache();
+		std::wstring cached = FormatCacheResidency();
+
+		// write access needs a private mapping where the first write copies the page from the file system cache
+		MemoryMappedFile mem(_FileName, false, _Access != AccessMode::Read, advices[a]);
+		mem.SetReadAhead(_ReadAheadBytes);
+		if (mem.GetAdviceError() != 0)
+		{
+			_Results.Message(StringExtensions::Format(L"Advice %ls failed with error code: %d", MemoryMappedFile::ToString(advices[a]), mem.GetAdviceError()));
+		}
+		_Pattern.Prepare(mem.GetFileSize(), Platform::GetPageSize(), 1);
+		bool bPrefetch = _bPrefetch || advices[a] == Platform::MapAdvice::WillNeed;
+
+		for (size_t i = 0; i < phases.size(); i++)
+		{
+			std::vector<PerfCounterValues> counters(1);
+			Platform::MemoryCounters before, after;
+			Stopwatch sw;
+			if (bPrefetch && i == 0 && !mem.Prefetch(10000))
+			{
+				_Results.Message(StringExtensions::Format(L"Prefetch failed with error code: %d", Platform::GetLastError()));
+			}
+			double resident = mem.GetResidentFraction();
+
+			Platform::GetMemoryCounters(before);
+			mem.TouchPages(sw, false, 0, _bHistogram ? &histograms[a][i] : nullptr, _bPerfCounters ? &counters[0] : nullptr, &_Pattern, phases[i].Access);
+			auto ns = sw.Stop();
+			Platform::GetMemoryCounters(after);
+
+			_Results.AddRow(StringExtensions::Format(L"%ls\t%.0f\t%ls\t%ls\t%.3f\t%.3f\t%.1f\t%.3f\t%.3f\t%.0f\t%llu\t%llu\tFileMap %ls%ls", _FileName.c_str(), mem.GetFileSize() / (1024.0 * 1024.0),
+				MemoryMappedFile::ToString(advices[a]), i == 0 ? cached.c_str() : L"N.a.", i == 0 ? Stopwatch::ToMs(mem.GetMapTime()) : 0.0, bPrefetch && i == 0 ? Stopwatch::ToMs(mem.GetPrefetchTime()) : 0.0, resident * 100,
+				Stopwatch::ToMs(ns), AveragePageAccessTimeInus(ns, mem.GetFileSize(), Platform::GetPageSize()), MBPerSecond(mem.GetFileSize(), ns),
+				(unsigned long long)(after.PageFaults - before.PageFaults), (unsigned long long)(after.HardPageFaults - before.HardPageFaults), phases[i].Name, FormatPerf(counters).c_str()));
+		}
+	}
+
+	if (_bHistogram)
 	{
-		tmp = pB[i];
+		PrintLatencyHeader();
+		for (size_t a = 0; a < advices.size(); a++)
+		{
+			for (size_t i = 0; i < phases.size(); i++)
+			{
+				PrintLatency(1, histograms[a][i], StringExtensions::Format(L"FileMap %ls %ls", MemoryMappedFile::ToString(advices[a]), phases[i].Name).c_str());
+			}
+		}
 	}
 
+	if (_bMapThreads)
+	{
+		FileMappingThreadTest();
+	}
 }
-#pragma optimize("", on)
 
-// Copy memory from a source to a destination buffer where the source buffer is fully initialized and zeroed. 
-// The destination buffer is not yet touched and the first time subject to soft page faults.
-// To speed up the sequential memcpy we use 1-nThread threads to copy from each thread a portion of the array to the destination
-// to measure the cost of concurrent page faults along with concurrent memcpy.
-// This will increase the soft page fault time due to internal locks in the page fault implementation while the added concurrency will 
-// reduce the overall memcpy time.
-// On the second run we will effectively measure the memory bandwidth with this test.
-void Program::MemCopyTest()
+// Fault the file from 1 up to -mapthreads n threads for every -mapmode. The mappings are created before the threads start and
+// the pattern is prepared for the thread count except for overlapping where every thread touches all pages in the same order.
+// The cache is prepared before every step because the first step leaves the whole file resident.
+void Program::FileMappingThreadTest()
 {
-	wprintf(L"Threads\tSize_MB\tTime_ms\tus/Page\tMB/s\tScenario\n");
-
-	float maxMBs = 0.f;
+	const PageAccess access = GetAccessPhases()[0].Access;
+	const wchar_t *modeNames[] = { L"shared", L"overlapping", L"private" };
 
-	for (int nThread = 1; nThread <= _MemCopyThreads; nThread++)
-	{
-		void *pSource = VirtualAlloc(_BytesToMemCopy);
-		void *pDest = VirtualAlloc(_BytesToMemCopy);
+	_Results.BeginTable(L"filemapthreads", StringExtensions::Format(L"Threads\tSize_MB\tTime_ms\tus/Page\tMB/s\tScenario\tStartSkew_us\tEndSkew_us%ls", GetPerfHeader()), L"Threads\tSize_MB\tScenario");
 
-		::ZeroMemory(pSource, _BytesToMemCopy);
+	// thread count, scenario and merged histogram of every step
+	std::vector<std::tuple<int, std::wstring, Histogram>> latencies;
+	WorkerPool pool(_MapThreadCount, [=](int i) { return PinWorkerThread(i); });
 
-		for (int run = 0; run < 2; run++)
+	for (int nThreads = 1; nThreads <= _MapThreadCount; nThreads++)
+	{
+		for (MapMode mode : _MapModes)
 		{
-			std::vector<std::thread> copyThreads;
-
-			Stopwatch sw;
-			__int64 sizePerThread = _BytesToMemCopy / nThread;
+			PrepareCache();
 
-			for (int i = 0; i < nThread; i++)
+			// write access needs a private mapping where the first write copies the page from the file system cache
+			std::vector<std::unique_ptr<MemoryMappedFile>> mappings;
+			try
 			{
-				copyThreads.push_back(std::thread([=]
+				for (int i = 0; i < (mode == MapMode::Private ? nThreads : 1); i++)
 				{
-					memcpy(((byte *)pDest) + i*sizePerThread, ((byte *)pSource) + i*sizePerThread, sizePerThread);
-				}));
+					mappings.push_back(std::unique_ptr<MemoryMappedFile>(new MemoryMappedFile(_FileName, false, _Access != AccessMode::Read)));
+				}
+			}
+			catch (std::exception &)
+			{
+				_Results.Message(StringExtensions::Format(L"Could not map %ls. Error: %d", _FileName.c_str(), Platform::GetLastError()));
+				return;
 			}
+			size_t fileSize = mappings[0]->GetFileSize();
+			_Pattern.Prepare(fileSize, Platform::GetPageSize(), mode == MapMode::Overlapping ? 1 : nThreads);
 
-			for (auto &t : copyThreads)
+			std::vector<std::unique_ptr<Histogram>> histograms;
+			for (int i = 0; _bHistogram && i < nThreads; i++)
 			{
-				t.join();
+				histograms.push_back(std::unique_ptr<Histogram>(new Histogram()));
 			}
-			auto ms = sw.Stop();
-			auto MB = _BytesToMemCopy / (1024LL * 1024LL);
-			float MBs = MB / (ms.count() / 1000.0f);
-			wprintf(L"%d\t%lld\t%lld\t%.3f\t%.0f\tTouch_%d\n", nThread, MB, ms.count(), AveragePageAccessTimeInus(ms, _BytesToMemCopy), MBs, run + 1);
-			maxMBs = max(maxMBs, MBs);
-		}
+			std::vector<PerfCounterValues> counters(nThreads);
 
-		VirtualFree(pSource);
-		VirtualFree(pDest);
+			pool.Run(nThreads, [&](int i)
+			{
+				PerfCounterScope perf(_bPerfCounters ? &counters[i] : nullptr);
+				void *p = mappings[mode == MapMode::Private ? i : 0]->GetAddress();
+				_Pattern.Touch(p, mode == MapMode::Overlapping ? 0 : i, access, _bHistogram ? histograms[i].get() : nullptr);
+			});
+
+			auto ns = pool.GetWallTime();
+			size_t bytes = mode == MapMode::Overlapping ? fileSize * nThreads : fileSize;
+			std::wstring scenario = StringExtensions::Format(L"FileMap %ls", modeNames[(int)mode]);
+			_Results.AddRow(StringExtensions::Format(L"%d\t%.0f\t%.3f\t%.3f\t%.0f\t%ls%ls%ls", nThreads, fileSize / (1024.0 * 1024.0), Stopwatch::ToMs(ns), AveragePageAccessTimeInus(ns, bytes, Platform::GetPageSize()),
+				MBPerSecond(bytes, ns), scenario.c_str(), FormatSkew(pool).c_str(), FormatPerf(counters).c_str()));
+
+			if (_bHistogram)
+			{
+				Histogram merged;
+				for (auto &histogram : histograms)
+				{
+					merged.Merge(*histogram);
+				}
+				latencies.push_back(std::make_tuple(nThreads, scenario, merged));
+			}
+		}
 	}
 
-	if (_MemCopyThreads > 3)
+	if (_bHistogram)
 	{
-		wprintf(L"Estimated duplex memory bandwidth: %.0f MB/s\n", maxMBs);
+		PrintLatencyHeader();
+		for (auto &latency : latencies)
+		{
+			PrintLatency(std::get<0>(latency), std::get<2>(latency), std::get<1>(latency).c_str());
+		}
 	}
 }
 
 
-/// Create test file with random data 
-void Program::CreateTestFile()
+// Load the file with every method once with a cold and once with a warm file system cache and with -cache additionally with a
+// partially cached file. The cache is warmed with a buffered read before the warm run because an unbuffered (direct) cold run leaves the file uncached. Buffered read, direct
+// and io_uring run once per -buffers size, pread additionally from 1 up to -ingestthreads n threads.
+void Program::IngestTest()
 {
-	HANDLE h = FileExtensions::CreateWriteableFile(_FileName);
-	const int BufferSize = 1 * 1024 * 1024;
+	std::vector<FileIngest::Method> methods = _IngestMethods;
+	if (methods.empty())
+	{
+		for (auto method : { FileIngest::Method::Mmap, FileIngest::Method::Read, FileIngest::Method::Pread, FileIngest::Method::Direct, FileIngest::Method::IoUring })
+		{
+			if (FileIngest::IsSupported(method))
+			{
+				methods.push_back(method);
+			}
+		}
+	}
+	std::vector<size_t> buffers = _IngestBuffers.empty() ? std::vector<size_t>{ 4 * 1024, 64 * 1024, 1024 * 1024 } : _IngestBuffers;
 
-	std::unique_ptr<byte> buffer(new byte[BufferSize]);
-	std::random_device rand;
+	std::vector<std::wstring> cacheStates = { L"cold", L"warm" };
+	if (_CachePercent >= 0)
+	{
+		cacheStates.push_back(StringExtensions::Format(L"%g%%:%ls", _CachePercent, CacheState::ToString(_CacheLayout)));
+	}
 
-	DWORD dwWritten = 0;
-	BOOL lWrite;
-	for (__int64 offset = 0; offset < _BytesToAllocate; offset += BufferSize)
+	_Results.BeginTable(L"ingest", L"File\tMethod\tCache\tCached_%\tBuffer_KB\tThreads\tQueueDepth\tSize_MB\tTime_ms\tMB/s\tUser_ms\tSystem_ms\tCPU_%",
+		L"File\tMethod\tCache\tBuffer_KB\tThreads\tQueueDepth");
+	for (auto method : methods)
 	{
-		// fill in random data to prevent dirty tricks of OS to treat it as empty pages or 
-		// to employ memory compression, page sharing and such things
-		for (int i = 0; i < BufferSize/4; i++)
+		std::vector<FileIngest::Options> configurations;
+		for (size_t buffer : method == FileIngest::Method::Mmap ? std::vector<size_t>{ Platform::GetPageSize() } : buffers)
 		{
-			((int *)buffer.get())[i] = rand();
+			for (int threads = 1; threads <= (method == FileIngest::Method::Pread ? _IngestThreads : 1); threads++)
+			{
+				FileIngest::Options options;
+				options.BufferBytes = buffer;
+				options.Threads = threads;
+				options.QueueDepth = method == FileIngest::Method::IoUring ? _QueueDepth : 1;
+				configurations.push_back(options);
+			}
 		}
 
-		lWrite = ::WriteFile(h, buffer.get(), BufferSize, &dwWritten, nullptr);
-		if (lWrite == FALSE)
+		for (auto &options : configurations)
 		{
-			wprintf(L"Error: Could not write to file %s, LastError: %d\n", _FileName.c_str(), ::GetLastError());
-			break;
+			for (auto &cacheState : cacheStates)
+			{
+				if (cacheState == L"cold" && !CacheState::Evict(_FileName))
+				{
+					_Results.Message(StringExtensions::Format(L"Warning: Could not evict %ls from the file system cache: %d", _FileName.c_str(), Platform::GetLastError()));
+				}
+				else if (cacheState == L"warm")
+				{
+					FileIngest::Load(_FileName, FileIngest::Method::Read, FileIngest::Options());
+				}
+				else if (cacheState != L"cold")
+				{
+					PrepareCache();
+				}
+
+				std::wstring cached = FormatCacheResidency();
+				FileIngest::Result result = FileIngest::Load(_FileName, method, options);
+				std::wstring row = StringExtensions::Format(L"%ls\t%ls\t%ls\t%ls\t%zu\t%d\t%d", _FileName.c_str(), FileIngest::ToString(method), cacheState.c_str(), cached.c_str(),
+					options.BufferBytes / 1024, options.Threads, options.QueueDepth);
+				if (result.Error != 0)
+				{
+					// the bytes which were read before the error, no throughput of an incomplete load
+					_Results.AddRow(row + StringExtensions::Format(L"\t%.0f\tN.a.\tN.a.\tN.a.\tN.a.\tN.a.\tError: %d", result.Bytes / (1024.0 * 1024.0), result.Error));
+					continue;
+				}
+
+				auto cpu = result.UserTime + result.SystemTime;
+				_Results.AddRow(row + StringExtensions::Format(L"\t%.0f\t%.3f\t%.0f\t%.3f\t%.3f\t%.1f", result.Bytes / (1024.0 * 1024.0), Stopwatch::ToMs(result.Time),
+					MBPerSecond(result.Bytes, result.Time), Stopwatch::ToMs(result.UserTime), Stopwatch::ToMs(result.SystemTime),
+					result.Time.count() == 0 ? 0.0 : 100.0 * cpu.count() / result.Time.count()));
+			}
 		}
 	}
+}
+
+// Put the file into the -cache state or evict it with -flush
+void Program::PrepareCache()
+{
+	if (_CachePercent < 0 && _bFlushFileSystemCache && !CacheState::Evict(_FileName))
+	{
+		_Results.Message(StringExtensions::Format(L"Warning: Could not evict %ls from the file system cache: %d", _FileName.c_str(), Platform::GetLastError()));
+	}
 
-	if (lWrite)
+	if (_CachePercent >= 0 && !CacheState::Prepare(_FileName, _CachePercent, _CacheLayout))
 	{
-		wprintf(L"Created file %s of size %lld MB\n", _FileName.c_str(), _BytesToAllocate / (1024LL * 1024LL));
+		_Results.Message(StringExtensions::Format(L"Warning: Could not put %ls into a %g%% %ls cached state: %d", _FileName.c_str(), _CachePercent,
+			CacheState::ToString(_CacheLayout), Platform::GetLastError()));
 	}
-	::CloseHandle(h);
 }
 
-///
-void Program::FileMappingTest()
+// Resident part of the file in percent measured with mincore or N.a.
+std::wstring Program::FormatCacheResidency()
 {
-	MemoryMappedFile mem(_FileName, _bFlushFileSystemCache);
-	Stopwatch sw;
-	mem.TouchPages(sw, _bPrefetch);
-	auto ms = sw.Stop();
-	float MB = (float)(mem.GetFileSize() / (1024LL * 1024LL));
-	float s = ((float)ms.count() / 1000.0f);
-	wprintf(L"Read file %s in %lldms with %.0f MB/s, %.3fus/page", _FileName.c_str(), ms.count(), MB/s, AveragePageAccessTimeInus(ms, mem.GetFileSize()));
+	double resident = CacheState::GetResidentFraction(_FileName);
+	return resident < 0 ? L"N.a." : StringExtensions::Format(L"%.1f", resident * 100);
 }
 
-
-
 void Program::LockMemory(void *pBuffer, const size_t N)
 {
-	PROCESS_MEMORY_COUNTERS counters;
-	BOOL ret = ::GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters));
-	if (!ret)
+	if (!Platform::GrowLockLimit(2500uLL * 1024 * 1024, 3000uLL * 1024 * 1024))
 	{
-		wprintf(L"GetProcessMemory failed: %d\n", ::GetLastError());
-		return;
+		_Results.Message(StringExtensions::Format(L"Could not raise the lock limit: %d", Platform::GetLastError()));
 	}
 
-	auto setws = SetProcessWorkingSetSize(::GetCurrentProcess(), counters.WorkingSetSize + 2500uL * 1024 * 1024, 3000uL * 1024 * 1024);
-
 	Stopwatch sw;
 	sw.Start();
-	BOOL lLock = VirtualLock((byte *)pBuffer, N);
+	bool lLock = Platform::Lock(pBuffer, N);
 	auto lockTime = sw.Stop();
 
-	wprintf(L"Locked %lld MB in %llums, %.3fus/page\n",
+	_Results.Message(StringExtensions::Format(L"Locked %lld MB in %.3fms, %.3fus/page",
 		N / (1024LL * 1024), 
-		lockTime.count(),
-		AveragePageAccessTimeInus(lockTime, N));
+		Stopwatch::ToMs(lockTime),
+		AveragePageAccessTimeInus(lockTime, N)));
 
-	if (lLock == FALSE)
+	if (!lLock)
 	{
-		wprintf(L"VirtualLock failed with %d\n", ::GetLastError());
+		_Results.Message(StringExtensions::Format(L"Lock failed with %d", Platform::GetLastError()));
 	}
 }
 
@@ -332,6 +1548,7 @@ bool Program::Parse()
 {
 	bool lret = true;
 	int nAllCores = std::thread::hardware_concurrency(); // up to all cores
+	_TestData.Threads = nAllCores;
 
 	auto argsMap = std::map<std::wstring, std::function<void()>>{
 		{ L"-flush",  [=]() { _bFlushFileSystemCache = true; } },
@@ -348,14 +1565,271 @@ bool Program::Parse()
 								 _Wait = true;
 						   } },
 		{ L"-prefetch", [=]() { _bPrefetch = true; } },
+		{ L"-advice", [=]() {
+								auto advices = GetNextArg();
+								if (advices == L"all")
+								{
+									advices = L"normal,sequential,random,willneed,hugepage,populate";
+								}
+								for (auto &name : StringExtensions::SplitList(advices))
+								{
+									Platform::MapAdvice advice = Platform::MapAdvice::Normal;
+									if (!MemoryMappedFile::ParseAdvice(name, advice))
+									{
+										_Errors.push_back(StringExtensions::Format(L"Error: Invalid mapping hint %ls passed to -advice. Valid values are normal, sequential, random, willneed, hugepage, populate and all\n", name.c_str()));
+									}
+									else if (!MemoryMappedFile::IsSupported(advice))
+									{
+										_Errors.push_back(StringExtensions::Format(L"Error: The mapping hint %ls is not supported on this platform\n", name.c_str()));
+									}
+									else
+									{
+										_Advices.push_back(advice);
+									}
+								}
+							} },
+		{ L"-readahead", [=]() {
+								// madvise needs page aligned windows
+								const size_t pageSize = Platform::GetPageSize();
+								_ReadAheadBytes = (1024ULL * ConvertToInt(GetNextArg()) + pageSize - 1) / pageSize * pageSize;
+							} },
+		{ L"-histogram", [=]() { _bHistogram = true; } },
+		{ L"-tsc", [=]() { _bTsc = true; } },
+		{ L"-perf", [=]() { _bPerfCounters = true; } },
 		{ L"-lock", [=]() { _bLockPages = true; } },
+		{ L"-access", [=]() {
+								auto access = GetNextArg();
+								if (access == L"read") { _Access = AccessMode::Read; }
+								else if (access == L"write") { _Access = AccessMode::Write; }
+								else if (access == L"readthenwrite") { _Access = AccessMode::ReadThenWrite; }
+								else if (access == L"rmw") { _Access = AccessMode::Rmw; }
+								else { _Errors.push_back(StringExtensions::Format(L"Error: Invalid access mode %ls passed to -access. Valid values are read, write, readthenwrite and rmw\n", access.c_str())); }
+							} },
+		{ L"-pattern", [=]() {
+								auto pattern = GetNextArg();
+								if (!AccessPattern::Parse(pattern, _Pattern))
+								{
+									_Errors.push_back(StringExtensions::Format(L"Error: Invalid access pattern %ls passed to -pattern. Valid values are sequential, reverse, stride:N, random and interleaved\n", pattern.c_str()));
+								}
+							} },
+		{ L"-pagesize", [=]() {
+								auto pageSize = GetNextArg();
+								if (pageSize == L"4k") { _PageSize = Platform::PageSize::Default; }
+								else if (pageSize == L"2m") { _PageSize = Platform::PageSize::Large2MB; }
+								else if (pageSize == L"1g") { _PageSize = Platform::PageSize::Huge1GB; }
+								else if (pageSize == L"thp") { _PageSize = Platform::PageSize::Transparent; }
+								else { _Errors.push_back(StringExtensions::Format(L"Error: Invalid page size %ls passed to -pagesize. Valid values are 4k, 2m, 1g and thp\n", pageSize.c_str())); }
+								if (!Platform::IsSupported(_PageSize))
+								{
+									_Errors.push_back(StringExtensions::Format(L"Error: The page size %ls is not supported on this platform\n", pageSize.c_str()));
+								}
+							 } },
+		{ L"-numa", [=]() {
+								auto policy = GetNextArg();
+								if (!Numa::ParsePolicy(policy, _NumaPolicy, _NumaBindNode))
+								{
+									_Errors.push_back(StringExtensions::Format(L"Error: Invalid NUMA policy %ls passed to -numa. Valid values are local, interleave, firsttouch and bind:node with the nodes %ls\n", policy.c_str(), Numa::GetNodeIds().c_str()));
+								}
+							} },
+		{ L"-affinity", [=]() {
+								auto affinity = GetNextArg();
+								if (!Numa::ParseAffinity(affinity, _Affinity))
+								{
+									_Errors.push_back(StringExtensions::Format(L"Error: Invalid thread affinity %ls passed to -affinity. Valid values are compact, scatter and pernode\n", affinity.c_str()));
+								}
+							} },
 		{ L"-N", [=]() { _BytesToAllocate = 1024LL * 1024LL * ConvertToInt(GetNextArg());  } },
 		{ L"-memcopy", [=]() { _BytesToMemCopy = 1024LL * 1024LL * ConvertToInt(GetNextArg());
 							 _Action = Action::MemCpy;
 							 } },
+		{ L"-prefault", [=]() { _BytesToAllocate = 1024LL * 1024LL * ConvertToInt(GetNextArg());
+							 _Action = Action::Prefault;
+							 } },
+		{ L"-bandwidth", [=]() { _BytesToAllocate = 1024LL * 1024LL * ConvertToInt(GetNextArg());
+							 _Action = Action::Bandwidth;
+							 } },
+		{ L"-bandwidththreads", [=]() { _BandwidthThreads = ConvertToInt(GetNextArg(), L"all", nAllCores); } },
+		{ L"-sweep", [=]() {
+								auto range = GetNextArg();
+								double minMB = 0, maxMB = 0, factor = 2;
+								int n = swscanf(range.c_str(), L"%lf:%lf:%lf", &minMB, &maxMB, &factor);
+								if (n < 2 || minMB <= 0 || maxMB < minMB || factor <= 1)
+								{
+									_Errors.push_back(StringExtensions::Format(L"Error: Invalid range %ls passed to -sweep. The format is min:max[:factor] in MB with factor > 1\n", range.c_str()));
+									return;
+								}
+								for (double mb = minMB; mb <= maxMB * 1.0001; mb *= factor)
+								{
+									size_t bytes = (size_t)(mb * 1024 * 1024);
+									if (_SweepSizes.empty() || _SweepSizes.back() != bytes)
+									{
+										_SweepSizes.push_back(bytes);
+									}
+								}
+								_Action = Action::Sweep;
+							} },
+		{ L"-allocators", [=]() { _BytesToAllocate = 1024LL * 1024LL * ConvertToInt(GetNextArg());
+							 _Action = Action::Allocators;
+							 } },
+		{ L"-strategies", [=]() {
+								auto strategies = GetNextArg();
+								if (strategies == L"all")
+								{
+									return;
+								}
+								for (auto &name : StringExtensions::SplitList(strategies))
+								{
+									Allocator::Config config;
+									if (!Allocator::Parse(name, config))
+									{
+										_Errors.push_back(StringExtensions::Format(L"Error: Invalid allocation strategy %ls passed to -strategies. Valid values are mmap, arena, dontneed, free, malloc, malloc:T and all\n", name.c_str()));
+									}
+									else if (!Allocator::IsSupported(config))
+									{
+										_Errors.push_back(StringExtensions::Format(L"Error: The allocation strategy %ls is not supported on this platform\n", name.c_str()));
+									}
+									else
+									{
+										_Strategies.push_back(config);
+									}
+								}
+							} },
+		{ L"-blocksize", [=]() { _BlockBytes = 1024ULL * ConvertToInt(GetNextArg()); } },
 		{ L"-memcopythreads", [=]() { _MemCopyThreads = ConvertToInt(GetNextArg(), L"all", nAllCores); } },
+		{ L"-kernels", [=]() {
+								auto kernels = GetNextArg();
+								if (kernels == L"all")
+								{
+									for (auto kernel : { CopyKernel::Kind::Memcpy, CopyKernel::Kind::RepMovsb, CopyKernel::Kind::Avx2, CopyKernel::Kind::Avx512, CopyKernel::Kind::NonTemporal, CopyKernel::Kind::Prefault })
+									{
+										if (CopyKernel::IsSupported(kernel))
+										{
+											_CopyKernels.push_back(kernel);
+										}
+									}
+									return;
+								}
+								for (auto &name : StringExtensions::SplitList(kernels))
+								{
+									CopyKernel::Kind kernel = CopyKernel::Kind::Memcpy;
+									if (!CopyKernel::Parse(name, kernel))
+									{
+										_Errors.push_back(StringExtensions::Format(L"Error: Invalid copy kernel %ls passed to -kernels. Valid values are memcpy, movsb, avx2, avx512, nt, prefault and all\n", name.c_str()));
+									}
+									else if (!CopyKernel::IsSupported(kernel))
+									{
+										_Errors.push_back(StringExtensions::Format(L"Error: The copy kernel %ls is not supported by this CPU\n", name.c_str()));
+									}
+									else
+									{
+										_CopyKernels.push_back(kernel);
+									}
+								}
+							} },
 		{ L"-touchthreads", [=]() { _TouchThreads = ConvertToInt(GetNextArg(), L"all", nAllCores); } },
-		{ L"-mapthreads", [=]() { _MapThreadCount = ConvertToInt(GetNextArg()); } },
+		{ L"-mapthreads", [=]() { _MapThreadCount = ConvertToInt(GetNextArg(), L"all", nAllCores);
+								_bMapThreads = true;
+							 } },
+		{ L"-mapmode", [=]() {
+								auto mode = GetNextArg();
+								if (mode == L"shared") { _MapModes = { MapMode::Shared }; }
+								else if (mode == L"overlapping") { _MapModes = { MapMode::Overlapping }; }
+								else if (mode == L"private") { _MapModes = { MapMode::Private }; }
+								else if (mode == L"all") { _MapModes = { MapMode::Shared, MapMode::Overlapping, MapMode::Private }; }
+								else { _Errors.push_back(StringExtensions::Format(L"Error: Invalid mapping mode %ls passed to -mapmode. Valid values are shared, overlapping, private and all\n", mode.c_str())); }
+							} },
+		{ L"-interfere", [=]() {
+								auto spec = GetNextArg();
+								Interference::Activity activity;
+								if (!Interference::Parse(spec, activity))
+								{
+									_Errors.push_back(StringExtensions::Format(L"Error: Invalid background activity %ls passed to -interfere. Use kind[:threads[:rate]] with kind mmap, mprotect, alloc, fork or thp\n", spec.c_str()));
+								}
+								else if (!Interference::IsSupported(activity.Type))
+								{
+									_Errors.push_back(StringExtensions::Format(L"Error: The background activity %ls is not supported on this platform\n", spec.c_str()));
+								}
+								else
+								{
+									_Activities.push_back(activity);
+								}
+							} },
+		{ L"-duration", [=]() { _DurationSeconds = ConvertToInt(GetNextArg()); } },
+		{ L"-iterations", [=]() { _Iterations = ConvertToInt(GetNextArg()); } },
+		{ L"-interval", [=]() { _IntervalMs = ConvertToInt(GetNextArg()); } },
+		{ L"-repeat", [=]() { _Repeat = ConvertToInt(GetNextArg()); } },
+		{ L"-warmup", [=]() { _Warmup = ConvertToInt(GetNextArg()); } },
+		{ L"-outliers", [=]() { _bRejectOutliers = true; } },
+		{ L"-save", [=]() { _SaveFile = GetNextArg(); } },
+		{ L"-ingest", [=]() {  _FileName = GetNextArg();
+								_Action = Action::Ingest;
+							 } },
+		{ L"-methods", [=]() {
+								auto methods = GetNextArg();
+								for (auto &name : StringExtensions::SplitList(methods))
+								{
+									FileIngest::Method method = FileIngest::Method::Mmap;
+									if (!FileIngest::Parse(name, method))
+									{
+										_Errors.push_back(StringExtensions::Format(L"Error: Invalid method %ls passed to -methods. Valid values are mmap, read, pread, direct and uring\n", name.c_str()));
+									}
+									else if (!FileIngest::IsSupported(method))
+									{
+										_Errors.push_back(StringExtensions::Format(L"Error: The method %ls is not supported on this platform\n", name.c_str()));
+									}
+									else
+									{
+										_IngestMethods.push_back(method);
+									}
+								}
+							} },
+		{ L"-buffers", [=]() {
+								auto buffers = GetNextArg();
+								for (auto &size : StringExtensions::SplitList(buffers))
+								{
+									int kb = ConvertToInt(size);
+									if (kb <= 0)
+									{
+										_Errors.push_back(StringExtensions::Format(L"Error: Invalid buffer size %ls passed to -buffers\n", size.c_str()));
+									}
+									else
+									{
+										_IngestBuffers.push_back(1024ULL * kb);
+									}
+								}
+							} },
+		{ L"-cache", [=]() {
+								auto cache = GetNextArg();
+								if (!CacheState::Parse(cache, _CachePercent, _CacheLayout))
+								{
+									_Errors.push_back(StringExtensions::Format(L"Error: Invalid cache state %ls passed to -cache. Use pct[:layout] with pct 0-100 and layout head, tail, interleaved or random\n", cache.c_str()));
+								}
+							} },
+		{ L"-content", [=]() {
+								auto content = GetNextArg();
+								if (!TestData::Parse(content, _TestData))
+								{
+									_Errors.push_back(StringExtensions::Format(L"Error: Invalid content profile %ls passed to -content. Valid values are random, zero, compressible[:ratio] and sparse[:datapercent]\n", content.c_str()));
+								}
+							} },
+		{ L"-createthreads", [=]() { _TestData.Threads = ConvertToInt(GetNextArg(), L"all", nAllCores); } },
+		{ L"-ingestthreads", [=]() { _IngestThreads = ConvertToInt(GetNextArg(), L"all", nAllCores); } },
+		{ L"-queuedepth", [=]() { _QueueDepth = ConvertToInt(GetNextArg()); } },
+		{ L"-compare", [=]() {  _BaselineFile = GetNextArg();
+								_FileName = GetNextArg();
+								_Action = Action::Compare;
+							 } },
+		{ L"-threshold", [=]() { _ThresholdPercent = ConvertToInt(GetNextArg()); } },
+		{ L"-format", [=]() {
+								auto format = GetNextArg();
+								ResultSink::Format resultFormat = ResultSink::Format::Table;
+								if (!ResultSink::ParseFormat(format, resultFormat))
+								{
+									_Errors.push_back(StringExtensions::Format(L"Error: Invalid output format %ls passed to -format. Valid values are table, csv and json\n", format.c_str()));
+								}
+								_Results.SetFormat(resultFormat);
+							} },
+		{ L"-processes", [=]() { _ProcessCount = ConvertToInt(GetNextArg(), L"all", nAllCores); } },
 	};
 
 	while (_Args.size() > 0)
@@ -365,7 +1839,7 @@ bool Program::Parse()
 		auto action = argsMap[currentArg];
 		if (action == nullptr)
 		{
-			_Errors.push_back(StringExtensions::Format(L"Error: Invalid argument: %s detected\n", currentArg.c_str()));
+			_Errors.push_back(StringExtensions::Format(L"Error: Invalid argument: %ls detected\n", currentArg.c_str()));
 			lret = false;
 		}
 		else
@@ -379,18 +1853,45 @@ bool Program::Parse()
 		_Action = Action::Memory;
 	}
 
+	_PageBytes = Platform::GetPageSizeBytes(_PageSize);
+	if (_PageBytes == 0)
+	{
+		lret = false;
+		_Errors.push_back(L"Error: The selected page size is not supported by this machine\n");
+	}
+	else if (_Action == Action::Memory || _Action == Action::Prefault || _Action == Action::Bandwidth)
+	{
+		_BytesToAllocate = RoundToPageSize(_BytesToAllocate);
+	}
+	else if (_Action == Action::MemCpy)
+	{
+		_BytesToMemCopy = RoundToPageSize(_BytesToMemCopy);
+	}
+
 	if (_BytesToAllocate == 0 &&  _Action == Action::Memory)
 	{
 		lret = false;
 		_Errors.push_back(L"Error: Invalid parameter passed to -N\n");
 	}
 
-	if (_BytesToAllocate == 0 && _Action == Action::CreateFileW  )
+	if (_BytesToAllocate == 0 && _Action == Action::Prefault)
+	{
+		lret = false;
+		_Errors.push_back(L"Error: Invalid parameter passed to -prefault\n");
+	}
+
+	if (_BytesToAllocate == 0 && _Action == Action::CreateFile  )
 	{
 		lret = false;
 		_Errors.push_back(L"Error: Invalid parameter passed to -createfile as file size\n");
 	}
 
+	if (_TestData.Threads <= 0 && _Action == Action::CreateFile)
+	{
+		lret = false;
+		_Errors.push_back(L"Error: Invalid or no parameter passed to -createthreads\n");
+	}
+
 	if (_TouchThreads == 0 && _Action == Action::Memory)
 	{
 		lret = false;
@@ -409,12 +1910,128 @@ bool Program::Parse()
 		_Errors.push_back(L"Error: Invalid or no parameter passed to memcopythreads\n");
 	}
 
+	if (_Action == Action::MemCpy && _MemCopyThreads > 0 && _BytesToMemCopy > 0 && _BytesToMemCopy < (int64_t)_PageBytes * _MemCopyThreads)
+	{
+		lret = false;
+		_Errors.push_back(StringExtensions::Format(L"Error: -memcopy needs at least one page (%zu KB) per -memcopythreads thread\n", _PageBytes / 1024));
+	}
+
+	if (_Action == Action::Bandwidth && (_BytesToAllocate <= 0 || _BandwidthThreads <= 0))
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -bandwidth needs a size in MB and -bandwidththreads must be at least 1\n");
+	}
+
+	if (!_CopyKernels.empty() && (_Action != Action::MemCpy || _ProcessCount > 0))
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -kernels can only be used with -memcopy\n");
+	}
+
 	if (!_FileName.empty() && _Action == Action::Memory && !FileExtensions::FileExists(_FileName))
 	{
 		lret = false;
-		_Errors.push_back( StringExtensions::Format(L"Error: File %s was not found to read\n", _FileName.c_str()) );
+		_Errors.push_back( StringExtensions::Format(L"Error: File %ls was not found to read\n", _FileName.c_str()) );
+	}
+
+	if (!_FileName.empty() && _Action == Action::Memory)
+	{
+		Interference::Activity fileMap;
+		fileMap.Type = Interference::Kind::FileMap;
+		fileMap.Threads = _MapThreadCount;
+		fileMap.File = _FileName;
+		fileMap.bFlush = _bFlushFileSystemCache;
+		_Activities.insert(_Activities.begin(), fileMap);
+	}
+
+	if ((_DurationSeconds > 0 || (_Iterations > 0 && _Action != Action::Allocators)) && (_Action != Action::Memory || _ProcessCount > 0))
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -duration and -iterations can only be used with -N\n");
+	}
+
+	if (_Action == Action::Allocators && (_BytesToAllocate <= 0 || _BlockBytes == 0))
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -allocators needs a size in MB and -blocksize must be at least 1 KB\n");
+	}
+
+	if (_Action == Action::Allocators && _PageSize != Platform::PageSize::Default)
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -pagesize cannot be used with -allocators. The strategies use the default page size of malloc and mmap.\n");
+	}
+
+	if ((!_Strategies.empty() || _BlockBytes != 256 * 1024) && _Action != Action::Allocators)
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -strategies and -blocksize can only be used with -allocators\n");
+	}
+
+	if (_Action == Action::Compare && (_BaselineFile.empty() || _FileName.empty() || _ThresholdPercent < 0))
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -compare needs a baseline and a current result file and -threshold must not be negative\n");
+	}
+
+	if (_Action == Action::Ingest && (_IngestThreads <= 0 || _QueueDepth <= 0 || !FileExtensions::FileExists(_FileName)))
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -ingest needs an existing file, -ingestthreads and -queuedepth must be at least 1\n");
+	}
+
+	if (_CachePercent >= 0 && ((_Action != Action::FileMap && _Action != Action::Ingest) || _ProcessCount > 0))
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -cache can only be used with -filemap and -ingest\n");
+	}
+
+	if ((!_Advices.empty() || _ReadAheadBytes > 0) && (_Action != Action::FileMap || _ProcessCount > 0))
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -advice and -readahead can only be used with -filemap\n");
+	}
+
+	if (_MapThreadCount < 1 || (_MapModes.size() != 3 && (_Action != Action::FileMap || _ProcessCount > 0)))
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -mapthreads must be at least 1 and -mapmode can only be used with -filemap\n");
+	}
+
+	if (_Repeat < 1 || _Warmup < 0)
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -repeat must be at least 1 and -warmup must not be negative\n");
+	}
+
+	if (_DurationSeconds < 0 || _Iterations < 0 || _IntervalMs <= 0)
+	{
+		lret = false;
+		_Errors.push_back(L"Error: Invalid value passed to -duration, -iterations or -interval\n");
+	}
+
+	if (!_Activities.empty() && (_Action != Action::Memory || _ProcessCount > 0))
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -interfere and -file can only be used with -N\n");
+	}
+
+	if (_ProcessCount < 0 || (_ProcessCount > 0 && _Action != Action::Memory && _Action != Action::MemCpy && _Action != Action::FileMap))
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -processes needs a process count and can only be combined with -N, -memcopy or -filemap\n");
+	}
+
+	if (_ProcessCount > 0 && !ProcessGroup::IsSupported())
+	{
+		lret = false;
+		_Errors.push_back(L"Error: -processes is not supported on this platform\n");
 	}
 
+	if (_Errors.size() > 0)
+	{
+		lret = false;
+	}
 
 	return lret;
 }
@@ -428,7 +2045,7 @@ int Program::ConvertToInt(const std::wstring &arg, const std::wstring &specialSt
 	}
 	else
 	{
-		lret = _wtoi(arg.c_str());
+		lret = (int)wcstol(arg.c_str(), nullptr, 10);
 	}
 
 	return lret;
@@ -447,22 +2064,208 @@ std::wstring Program::GetNextArg()
 
 void * Program::VirtualAlloc(size_t n)
 {
-	void *lret = ::VirtualAlloc(NULL, n, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	void *lret = Numa::Allocate(n, _PageSize, _NumaPolicy, _NumaBindNode);
 
-	if (lret == NULL)
+	if (lret == nullptr)
 	{
-		wprintf(L"VirtualAlloc failed. Error: %ld\n", GetLastError());
+		_Results.Message(StringExtensions::Format(L"VirtualAlloc failed. Error: %d", Platform::GetLastError()));
+		if (_PageSize == Platform::PageSize::Large2MB || _PageSize == Platform::PageSize::Huge1GB)
+		{
+			_Results.Message(L"Large pages need to be reserved up front (vm.nr_hugepages / SeLockMemoryPrivilege).");
+		}
 	}
 
 	return lret;
 }
 
-void Program::VirtualFree(void *pMemory)
+size_t Program::RoundToPageSize(size_t n)
+{
+	return (n + _PageBytes - 1) / _PageBytes * _PageBytes;
+}
+
+// Explicit huge pages are faulted in as a whole so touching one byte per page is enough.
+// Transparent huge pages can silently fall back to small pages which is why we still touch every small page.
+size_t Program::GetTouchStride()
+{
+	if (_PageSize == Platform::PageSize::Transparent)
+	{
+		return Platform::GetPageSize();
+	}
+	return _PageBytes;
+}
+
+void Program::PrintPageSize()
+{
+	if (_PageSize != Platform::PageSize::Default)
+	{
+		_Results.Message(StringExtensions::Format(L"Page size: %zu KB%ls", _PageBytes / 1024, _PageSize == Platform::PageSize::Transparent ? L" (transparent huge pages)" : L""));
+	}
+	if (_Pattern.GetKind() != AccessPattern::Kind::Sequential)
+	{
+		_Results.Message(StringExtensions::Format(L"Access pattern: %ls", _Pattern.ToString()));
+	}
+	if (IsNumaActive())
+	{
+		_Results.Message(StringExtensions::Format(L"NUMA nodes: %d, memory policy: %ls, thread affinity: %ls", Numa::GetNodeCount(), Numa::ToString(_NumaPolicy), Numa::ToString(_Affinity)));
+	}
+}
+
+// The measured passes of -access. The names are the fault types which are caused by the pass on fresh memory:
+// read maps the shared zero page (Linux), write allocates and zeroes a page, cow breaks the copy on write of the zero page
+// or of a private file page and rmw reads and writes every page in one pass.
+std::vector<AccessPhase> Program::GetAccessPhases()
+{
+	switch (_Access)
+	{
+	case AccessMode::Write: return { { PageAccess::Write, L"write" } };
+	case AccessMode::ReadThenWrite: return { { PageAccess::Read, L"read" }, { PageAccess::Write, L"cow" } };
+	case AccessMode::Rmw: return { { PageAccess::Rmw, L"rmw" } };
+	default: return { { PageAccess::Read, L"read" } };
+	}
+}
+
+// Per thread time and node of the last WorkerPool::Run for the per NUMA node breakdown
+std::vector<ThreadResult> Program::GetThreadResults(const WorkerPool &pool, int nThreads, size_t bytesPerThread)
+{
+	std::vector<ThreadResult> results(nThreads);
+	for (int i = 0; i < nThreads; i++)
+	{
+		results[i].Node = pool.GetNode(i);
+		results[i].Time = pool.GetThreadTime(i);
+		results[i].Bytes = bytesPerThread;
+	}
+	return results;
+}
+
+// Time between the first and the last thread which started and finished the work
+std::wstring Program::FormatSkew(const WorkerPool &pool)
+{
+	return StringExtensions::Format(L"\t%.3f\t%.3f", pool.GetStartSkew().count() / 1000.0, pool.GetEndSkew().count() / 1000.0);
+}
+
+// Pin the calling worker thread according to -affinity. Unpinned threads report the node they currently run on.
+int Program::PinWorkerThread(int threadIndex)
+{
+	int node = Numa::PinThread(_Affinity, threadIndex);
+	return node == -1 ? Numa::GetCurrentNode() : node;
+}
+
+// Repeat the work of every pinned thread once with buffers bound to the node of the thread and once with buffers bound to the
+// next node. Every thread gets its own buffers of ThreadResult::Bytes. prepare runs untimed before work. Without thread pinning
+// or with a single node there is no local and remote memory and nothing is measured.
+void Program::MeasureLocalRemote(WorkerPool &pool, std::vector<ThreadResult> &results, int buffers, std::function<void(int, char **)> prepare,
+	std::function<void(int, char **)> work)
+{
+	if (_Affinity == Numa::Affinity::None || Numa::GetNodeCount() < 2)
+	{
+		return;
+	}
+
+	int nThreads = (int)results.size();
+	for (int remote = 0; remote < 2; remote++)
+	{
+		std::vector<std::vector<char *>> memory(nThreads);
+		bool bAllocated = true;
+		for (int i = 0; i < nThreads; i++)
+		{
+			int node = remote == 0 ? results[i].Node : Numa::GetRemoteNode(results[i].Node);
+			for (int b = 0; b < buffers; b++)
+			{
+				memory[i].push_back((char *)Numa::Allocate(RoundToPageSize(results[i].Bytes), _PageSize, Numa::Policy::Bind, node));
+				bAllocated = bAllocated && memory[i].back() != nullptr;
+			}
+		}
+
+		if (bAllocated)
+		{
+			pool.Run(nThreads, [&](int i) { prepare(i, memory[i].data()); });
+			pool.Run(nThreads, [&](int i) { work(i, memory[i].data()); });
+			for (int i = 0; i < nThreads; i++)
+			{
+				(remote == 0 ? results[i].LocalTime : results[i].RemoteTime) = pool.GetThreadTime(i);
+			}
+		}
+		else
+		{
+			_Results.Message(StringExtensions::Format(L"Warning: Could not allocate the %ls node buffers. Error: %d", remote == 0 ? L"local" : L"remote", Platform::GetLastError()));
+		}
+
+		for (int i = 0; i < nThreads; i++)
+		{
+			for (char *p : memory[i])
+			{
+				if (p != nullptr)
+				{
+					VirtualFree(p, RoundToPageSize(results[i].Bytes));
+				}
+			}
+		}
+	}
+}
+
+// Aggregate the worker threads by the node they ran on. The node time is the time of the slowest thread of the node.
+// Local_MB/s and Remote_MB/s are measured by MeasureLocalRemote and N.a. when it did not run.
+void Program::AddNodeRows(int threads, const wchar_t *scenario, const std::vector<ThreadResult> &results)
+{
+	for (auto &numaNode : Numa::GetTopology())
+	{
+		int node = numaNode.Id;
+		int nodeThreads = 0;
+		size_t bytes = 0;
+		double localBytes = 0;
+		bool bLocalKnown = true;
+		std::chrono::nanoseconds time(0), localTime(0), remoteTime(0);
+		for (auto &result : results)
+		{
+			if (result.Node != node)
+			{
+				continue;
+			}
+			nodeThreads++;
+			bytes += result.Bytes;
+			time = (std::max)(time, result.Time);
+			localTime = (std::max)(localTime, result.LocalTime);
+			remoteTime = (std::max)(remoteTime, result.RemoteTime);
+			bLocalKnown = bLocalKnown && result.LocalFraction >= 0;
+			localBytes += result.Bytes * (result.LocalFraction < 0 ? 0 : result.LocalFraction);
+		}
+
+		if (nodeThreads == 0)
+		{
+			continue;
+		}
+
+		float MBs = MBPerSecond(bytes, time);
+		double localFraction = bytes == 0 ? 0 : localBytes / bytes;
+		std::wstring local = bLocalKnown ? StringExtensions::Format(L"%.1f", localFraction * 100.0) : L"N.a.";
+		std::wstring localMBs = localTime.count() == 0 ? L"N.a." : StringExtensions::Format(L"%.0f", MBPerSecond(bytes, localTime));
+		std::wstring remoteMBs = remoteTime.count() == 0 ? L"N.a." : StringExtensions::Format(L"%.0f", MBPerSecond(bytes, remoteTime));
+		_NodeRows.push_back(StringExtensions::Format(L"%d\t%d\t%d\t%ls\t%.3f\t%.0f\t%ls\t%ls\t%ls", threads, node, nodeThreads,
+			local.c_str(), Stopwatch::ToMs(time), MBs, localMBs.c_str(), remoteMBs.c_str(), scenario));
+	}
+}
+
+void Program::PrintNodeRows()
+{
+	if (_NodeRows.empty())
+	{
+		return;
+	}
+
+	_Results.BeginTable(L"node", L"Threads\tNode\tNodeThreads\tLocal_%\tTime_ms\tMB/s\tLocal_MB/s\tRemote_MB/s\tScenario", L"Threads\tNode\tNodeThreads\tScenario");
+	for (auto &row : _NodeRows)
+	{
+		_Results.AddRow(row);
+	}
+	_NodeRows.clear();
+}
+
+void Program::VirtualFree(void *pMemory, size_t n)
 {
-	BOOL lret = ::VirtualFree(pMemory, 0, MEM_RELEASE);
-	if (lret == FALSE)
+	bool lret = Platform::Free(pMemory, n);
+	if (!lret)
 	{
-		wprintf(L"Error: Could not free memory. LastError: %d\n", ::GetLastError());
+		_Results.Message(StringExtensions::Format(L"Error: Could not free memory. LastError: %d", Platform::GetLastError()));
 	}
 }
 
@@ -1,35 +1,126 @@
 #pragma once
 #include <queue>
 #include <string>
-#include <tchar.h>
+#include <vector>
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include "Platform.h"
+#include "Histogram.h"
+#include "PerfCounters.h"
+#include "Numa.h"
+#include "WorkerPool.h"
+#include "AccessPattern.h"
+#include "ProcessGroup.h"
+#include "Interference.h"
+#include "ResultSink.h"
+#include "FileIngest.h"
+#include "CacheState.h"
+#include "TestData.h"
+#include "CopyKernel.h"
+#include "Bandwidth.h"
+#include "Allocator.h"
 
 namespace FastPageFault
 {
+	// Measurement of a single worker thread which is needed for the per NUMA node breakdown
+	struct ThreadResult
+	{
+		int Node = -1;                  // node the thread ran on
+		std::chrono::nanoseconds Time;  // time from start to end of the work of this thread
+		size_t Bytes = 0;               // bytes touched or copied by this thread
+		double LocalFraction = -1;      // fraction of the thread's pages which are located on Node, -1 if unknown
+		std::chrono::nanoseconds LocalTime{ 0 };   // time of the same work with the memory bound to Node, 0 if not measured
+		std::chrono::nanoseconds RemoteTime{ 0 };  // time of the same work with the memory bound to Numa::GetRemoteNode(Node)
+	};
+
+	// Page fault type which is measured by a touch pass. ReadThenWrite runs a read pass followed by a write pass.
+	enum class AccessMode
+	{
+		Read = 0,
+		Write,
+		ReadThenWrite,
+		Rmw,
+	};
+
+	// How the -mapthreads threads map the file
+	enum class MapMode
+	{
+		Shared = 0,   // one mapping, every thread touches its part
+		Overlapping,  // one mapping, every thread touches all pages
+		Private,      // one mapping per thread, every thread touches its part
+	};
+
+	// One measured pass over the buffer
+	struct AccessPhase
+	{
+		PageAccess Access;
+		const wchar_t *Name;  // fault type which is appended to the scenario name
+	};
+
 	class Program
 	{
 	public:
 		Program(std::queue<std::wstring> &&args);
 		bool Parse();
-		void Execute();
+		int Execute();
 		bool ShouldWait() { return _Wait; }
 		void Help();
 		~Program();
 	private: // Program dependent methods
 		void LockMemory(void *pBuffer, const size_t N);
 		void Touch(void *p, size_t N);
-		float AveragePageAccessTimeInus(std::chrono::milliseconds ms, const size_t NBytes)
+		void TouchWrite(void *p, size_t N);
+		void PrintLatencyHeader();
+		const wchar_t *GetPerfHeader();
+		std::wstring FormatPerf(const std::vector<PerfCounterValues> &perThread);
+		void PrintLatency(int threads, const Histogram &histogram, const wchar_t *scenario);
+		float AveragePageAccessTimeInus(std::chrono::nanoseconds ns, const size_t NBytes, const size_t pageSize = 4096)
 		{
-			return std::chrono::duration_cast<std::chrono::microseconds>(ms).count() * 1.0f / (1.0f * (NBytes / 4096));
+			return (float)(ns.count() / 1000.0 / (NBytes / pageSize));
+		}
+		// Throughput in MB/s. Returns 0 if the measured time was 0 instead of dividing by zero.
+		float MBPerSecond(const size_t NBytes, std::chrono::nanoseconds ns)
+		{
+			return ns.count() == 0 ? 0.0f : (float)((NBytes / (1024.0 * 1024.0)) / (ns.count() / 1000000000.0));
 		}
 		void AllocateAndTouchMemory(size_t N);
 		void AllocateTest();
+		void InterferenceTest();
+		void ReportInterferenceErrors(const Interference &interference, const std::vector<Interference::Activity> &activities);
+		void SustainedTest();
 		void FileMappingTest();
+		void FileMappingThreadTest();
+		void IngestTest();
+		void PrepareCache();
+		std::wstring FormatCacheResidency();
 		void MemCopyTest();
+		void BandwidthTest();
+		void AllocatorTest();
+		void SweepTest();
+		std::chrono::nanoseconds MeasureBandwidth(WorkerPool &pool, int nThreads, Bandwidth::Kernel kernel, double *a, double *b, double *c, size_t elements, int iterations);
+		void PrefaultTest();
+		void ProcessTest();
+		std::vector<std::wstring> GetProcessSteps();
+		std::vector<ProcessGroup::Result> RunProcessSteps(ProcessGroup &group);
+		void MeasurePrefault(const wchar_t *strategy, int threads, std::function<void *(size_t n)> allocateResident);
 
 		void CreateTestFile();
 		void *VirtualAlloc(size_t n);
-		void VirtualFree(void *pMemory);
+		size_t RoundToPageSize(size_t n);
+		size_t GetTouchStride();
+		void PrintPageSize();
+		void AddMetadata();
+		std::vector<AccessPhase> GetAccessPhases();
+		bool IsNumaActive() { return _NumaPolicy != Numa::Policy::None || _Affinity != Numa::Affinity::None; }
+		int PinWorkerThread(int threadIndex);
+		void AddNodeRows(int threads, const wchar_t *scenario, const std::vector<ThreadResult> &results);
+		void MeasureLocalRemote(WorkerPool &pool, std::vector<ThreadResult> &results, int buffers, std::function<void(int, char **)> prepare,
+			std::function<void(int, char **)> work);
+		std::vector<ThreadResult> GetThreadResults(const WorkerPool &pool, int nThreads, size_t bytesPerThread);
+		std::wstring FormatSkew(const WorkerPool &pool);
+		void PrintNodeRows();
+		void VirtualFree(void *pMemory, size_t n);
 
 	private: // Helper Methods
 		int ConvertToInt(const std::wstring &arg, const std::wstring &specialStr=L"", int specialInt=0);
@@ -40,13 +131,50 @@ namespace FastPageFault
 		bool _bFlushFileSystemCache = false;
 		bool _bLockPages =false;
 		bool _bPrefetch = false;
-		__int64 _BytesToAllocate =0;
+		bool _bHistogram = false;
+		bool _bTsc = false;
+		bool _bPerfCounters = false;
+		int64_t _BytesToAllocate =0;
 		int _TouchThreads = 1;
 		int _MemCopyThreads = 1;
-		__int64 _BytesToMemCopy = 0;
-		volatile bool _bFinishTouching = false;
+		int _BandwidthThreads = 1;
+		std::vector<Allocator::Config> _Strategies;
+		size_t _BlockBytes = 256 * 1024;
+		std::vector<size_t> _SweepSizes;    // buffer sizes of -sweep in bytes
+		int64_t _BytesToMemCopy = 0;
+		std::vector<CopyKernel::Kind> _CopyKernels;
 		bool _Wait = false;
-		int _MapThreadCount;
+		int _MapThreadCount = 1;
+		bool _bMapThreads = false;       // -mapthreads was given
+		std::vector<MapMode> _MapModes = { MapMode::Shared, MapMode::Overlapping, MapMode::Private };
+		int _ProcessCount = 0;
+		int _DurationSeconds = 0;
+		int _Iterations = 0;
+		int _IntervalMs = 1000;
+		int _Repeat = 1;
+		int _Warmup = 0;
+		bool _bRejectOutliers = false;
+		std::wstring _SaveFile;
+		std::wstring _BaselineFile;
+		int _ThresholdPercent = 5;
+		std::vector<Platform::MapAdvice> _Advices;
+		size_t _ReadAheadBytes = 0;
+		std::vector<FileIngest::Method> _IngestMethods;
+		std::vector<size_t> _IngestBuffers;
+		int _IngestThreads = 1;
+		int _QueueDepth = 32;
+		double _CachePercent = -1;     // -cache, < 0 when not set
+		CacheState::Layout _CacheLayout = CacheState::Layout::Head;
+		TestData::Options _TestData;
+		std::vector<Interference::Activity> _Activities;
+		Platform::PageSize _PageSize = Platform::PageSize::Default;
+		size_t _PageBytes = 4096; // fault granularity of _PageSize
+		Numa::Policy _NumaPolicy = Numa::Policy::None;
+		int _NumaBindNode = 0;
+		Numa::Affinity _Affinity = Numa::Affinity::None;
+		std::vector<std::wstring> _NodeRows;
+		AccessPattern _Pattern;
+		AccessMode _Access = AccessMode::Read;
 		
 		enum Action
 		{
@@ -55,10 +183,19 @@ namespace FastPageFault
 			CreateFile = 2,
 			FileMap = 3,
 			MemCpy = 4,
+			Prefault = 5,
+			Compare = 6,
+			Ingest = 7,
+			Bandwidth = 8,
+			Allocators = 9,
+			Sweep = 10,
 		};
 
 		Action _Action = Action::None;
 
+		ResultSink _Results;
+		std::wstring _CommandLine;
+
 	private: // program independent variables
 		std::queue<std::wstring> _Args;
 		std::vector<std::wstring> _Errors;
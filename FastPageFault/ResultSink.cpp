@@ -0,0 +1,700 @@
+#include "stdafx.h"
+#include "ResultSink.h"
+#include <cmath>
+#include <cwchar>
+#include <map>
+
+bool ResultSink::ParseFormat(const std::wstring &str, Format &format)
+{
+	if (str == L"table") { format = Format::Table; }
+	else if (str == L"csv") { format = Format::Csv; }
+	else if (str == L"json") { format = Format::Json; }
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+void ResultSink::AddMetadata(const std::wstring &key, const std::wstring &value)
+{
+	_Metadata.push_back(std::make_pair(key, value));
+}
+
+void ResultSink::BeginTable(const std::wstring &name, const std::wstring &columns, const std::wstring &keys)
+{
+	Table table;
+	table.Name = name;
+	table.Columns = Split(columns);
+	if (!keys.empty())
+	{
+		table.Keys = Split(keys);
+	}
+
+	if (_bWarmup)
+	{
+		return;
+	}
+
+	if (_CollectedRuns.empty())
+	{
+		_CollectedRuns.push_back(std::vector<Table>());
+	}
+	_CollectedRuns.back().push_back(table);
+
+	if (_Runs == 1)
+	{
+		PrintHeader(table);
+		_Tables.push_back(table);
+	}
+}
+
+void ResultSink::AddRow(const std::wstring &values)
+{
+	if (_bWarmup)
+	{
+		return;
+	}
+
+	if (_CollectedRuns.empty() || _CollectedRuns.back().empty())
+	{
+		return;
+	}
+	_CollectedRuns.back().back().Rows.push_back(Split(values));
+
+	if (_Runs == 1)
+	{
+		PrintRow(_Tables.back(), Split(values));
+	}
+}
+
+void ResultSink::PrintHeader(const Table &table)
+{
+	std::wstring line = _Format == Format::Csv ? L"Table" : L"";
+	for (size_t i = 0; _Format == Format::Csv && i < _Metadata.size(); i++)
+	{
+		line += L"," + CsvField(_Metadata[i].first);
+	}
+	for (size_t i = 0; i < table.Columns.size(); i++)
+	{
+		line += _Format == Format::Csv ? L"," + CsvField(table.Columns[i]) : (i == 0 ? L"" : L"\t") + table.Columns[i];
+	}
+
+	if (_Format != Format::Json)
+	{
+		wprintf(L"%ls\n", line.c_str());
+	}
+}
+
+void ResultSink::PrintRow(const Table &table, const std::vector<std::wstring> &values)
+{
+	switch (_Format)
+	{
+	case Format::Table:
+	{
+		std::wstring line;
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			line += (i == 0 ? L"" : L"\t") + values[i];
+		}
+		wprintf(L"%ls\n", line.c_str());
+		break;
+	}
+	case Format::Csv:
+	{
+		std::wstring line = CsvField(table.Name);
+		for (auto &metadata : _Metadata)
+		{
+			line += L"," + CsvField(metadata.second);
+		}
+		for (auto &value : values)
+		{
+			line += L"," + CsvField(value);
+		}
+		wprintf(L"%ls\n", line.c_str());
+		break;
+	}
+	case Format::Json:
+		_Tables.back().Rows.push_back(values);
+		break;
+	}
+}
+
+void ResultSink::BeginRun(bool bWarmup)
+{
+	_bWarmup = bWarmup;
+	if (!bWarmup)
+	{
+		_CollectedRuns.push_back(std::vector<Table>());
+	}
+}
+
+// The first run defines the tables and rows. Tables and rows which are missing in other runs (e.g. a failed allocation)
+// reduce the number of values of the statistics.
+void ResultSink::EndRuns()
+{
+	_bWarmup = false;
+	while (!_CollectedRuns.empty() && _CollectedRuns.back().empty())
+	{
+		_CollectedRuns.pop_back();
+	}
+	if (!_SaveFile.empty() && !Save(_SaveFile))
+	{
+		Message(StringExtensions::Format(L"Error: Could not write the results to %ls", _SaveFile.c_str()));
+	}
+	if (_CollectedRuns.empty() || _Runs == 1)
+	{
+		_CollectedRuns.clear();
+		return;
+	}
+
+	for (size_t t = 0; t < _CollectedRuns[0].size(); t++)
+	{
+		const Table &first = _CollectedRuns[0][t];
+		std::vector<size_t> keyIndices;
+		std::wstring columns = first.Keys.empty() ? L"Row\t" : L"";
+		for (auto &key : first.Keys)
+		{
+			auto it = std::find(first.Columns.begin(), first.Columns.end(), key);
+			if (it != first.Columns.end())
+			{
+				keyIndices.push_back(it - first.Columns.begin());
+				columns += key + L"\t";
+			}
+		}
+		columns += L"Metric\tN\tMean\tMedian\tStdDev\tMin\tMax\tCI95_Low\tCI95_High\tRejected";
+
+		Table stats;
+		stats.Name = first.Name + L"_stats";
+		stats.Columns = Split(columns);
+		PrintHeader(stats);
+		_Tables.push_back(stats);
+
+		for (size_t r = 0; r < first.Rows.size(); r++)
+		{
+			std::wstring prefix = first.Keys.empty() ? StringExtensions::Format(L"%zu\t", r) : L"";
+			for (size_t key : keyIndices)
+			{
+				prefix += (key < first.Rows[r].size() ? first.Rows[r][key] : L"") + L"\t";
+			}
+
+			for (size_t c = 0; c < first.Columns.size() && c < first.Rows[r].size(); c++)
+			{
+				double number = 0;
+				if (std::find(keyIndices.begin(), keyIndices.end(), c) != keyIndices.end() || !ParseNumber(first.Rows[r][c], number))
+				{
+					continue;
+				}
+
+				std::vector<double> values;
+				for (auto &run : _CollectedRuns)
+				{
+					if (t < run.size() && r < run[t].Rows.size() && c < run[t].Rows[r].size() && ParseNumber(run[t].Rows[r][c], number))
+					{
+						values.push_back(number);
+					}
+				}
+
+				Statistics s = Calculate(values);
+				PrintRow(stats, Split(prefix + StringExtensions::Format(L"%ls\t%zu\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%zu", first.Columns[c].c_str(),
+					s.Count, s.Mean, s.Median, s.StdDev, s.Min, s.Max, s.ConfidenceLow, s.ConfidenceHigh, s.Rejected)));
+			}
+		}
+	}
+	_CollectedRuns.clear();
+}
+
+ResultSink::Statistics ResultSink::Calculate(std::vector<double> values) const
+{
+	Statistics s;
+	if (values.empty())
+	{
+		return s;
+	}
+
+	auto median = [](std::vector<double> sorted)
+	{
+		std::sort(sorted.begin(), sorted.end());
+		size_t n = sorted.size();
+		return n % 2 == 1 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+	};
+
+	if (_bRejectOutliers && values.size() > 2)
+	{
+		double center = median(values);
+		std::vector<double> deviations;
+		for (double value : values)
+		{
+			deviations.push_back(fabs(value - center));
+		}
+		double mad = 1.4826 * median(deviations); // scaled to the standard deviation of a normal distribution
+		std::vector<double> kept;
+		for (double value : values)
+		{
+			if (mad == 0 || fabs(value - center) <= 3 * mad)
+			{
+				kept.push_back(value);
+			}
+		}
+		s.Rejected = values.size() - kept.size();
+		values = kept;
+	}
+
+	s.Count = values.size();
+	s.Median = median(values);
+	s.Min = *std::min_element(values.begin(), values.end());
+	s.Max = *std::max_element(values.begin(), values.end());
+	s.Mean = Mean(values);
+	s.StdDev = sqrt(Variance(values));
+
+	// two sided 95% quantiles of the Student t distribution for 1-30 degrees of freedom
+	static const double t95[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+		2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+	size_t df = s.Count - 1;
+	double t = df == 0 ? 0 : (df <= 30 ? t95[df - 1] : 1.96);
+	double halfWidth = s.Count > 1 ? t * s.StdDev / sqrt((double)s.Count) : 0;
+	s.ConfidenceLow = s.Mean - halfWidth;
+	s.ConfidenceHigh = s.Mean + halfWidth;
+	return s;
+}
+
+bool ResultSink::ParseNumber(const std::wstring &value, double &number)
+{
+	wchar_t *pEnd = nullptr;
+	number = wcstod(value.c_str(), &pEnd);
+	return !value.empty() && (iswdigit(value[0]) || value[0] == L'-') && pEnd == value.c_str() + value.size() && number == number && number - number == 0; // no NaN or inf
+}
+
+double ResultSink::Mean(const std::vector<double> &values)
+{
+	double sum = 0;
+	for (double value : values)
+	{
+		sum += value;
+	}
+	return values.empty() ? 0 : sum / values.size();
+}
+
+// Sample variance
+double ResultSink::Variance(const std::vector<double> &values)
+{
+	double mean = Mean(values);
+	double sumSquares = 0;
+	for (double value : values)
+	{
+		sumSquares += (value - mean) * (value - mean);
+	}
+	return values.size() > 1 ? sumSquares / (values.size() - 1) : 0;
+}
+
+// Two sided p value of Welch's t-test which does not assume equal variances. Returns -1 when one side has less than 2 values.
+double ResultSink::WelchTTest(const std::vector<double> &a, const std::vector<double> &b)
+{
+	if (a.size() < 2 || b.size() < 2)
+	{
+		return -1;
+	}
+
+	double va = Variance(a) / a.size();
+	double vb = Variance(b) / b.size();
+	double diff = Mean(a) - Mean(b);
+	if (va + vb == 0)
+	{
+		return diff == 0 ? 1 : 0;
+	}
+
+	double t = diff / sqrt(va + vb);
+	double df = (va + vb) * (va + vb) / (va * va / (a.size() - 1) + vb * vb / (b.size() - 1));
+	return IncompleteBeta(df / 2, 0.5, df / (df + t * t));
+}
+
+// Regularized incomplete beta function I_x(a,b) evaluated with the continued fraction of Lentz's method
+double ResultSink::IncompleteBeta(double a, double b, double x)
+{
+	if (x <= 0 || x >= 1)
+	{
+		return x <= 0 ? 0 : 1;
+	}
+	if (x > (a + 1) / (a + b + 2))
+	{
+		return 1 - IncompleteBeta(b, a, 1 - x); // the continued fraction converges fast only below this point
+	}
+
+	const double tiny = 1e-300;
+	double front = exp(lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) + b * log(1 - x)) / a;
+	double f = 1, c = 1, d = 0;
+	for (int i = 0; i <= 400; i++)
+	{
+		int m = i / 2;
+		double numerator = 1;
+		if (i > 0)
+		{
+			numerator = i % 2 == 0 ? (m * (b - m) * x) / ((a + 2 * m - 1) * (a + 2 * m)) : -((a + m) * (a + b + m) * x) / ((a + 2 * m) * (a + 2 * m + 1));
+		}
+
+		d = 1 + numerator * d;
+		d = 1 / (fabs(d) < tiny ? tiny : d);
+		c = 1 + numerator / c;
+		c = fabs(c) < tiny ? tiny : c;
+		double cd = c * d;
+		f *= cd;
+		if (fabs(1 - cd) < 1e-10)
+		{
+			return front * (f - 1);
+		}
+	}
+	return front * (f - 1);
+}
+
+// File format: one record per line with tab separated fields.
+// M <key> <value>                 metadata
+// T <run> <table> <columns>...    start of a table of a run
+// K <key columns>...              key columns of the current table
+// R <values>...                   row of the current table
+bool ResultSink::Save(const std::wstring &file) const
+{
+	auto clean = [](std::wstring value)
+	{
+		std::replace(value.begin(), value.end(), L'\t', L' ');
+		std::replace(value.begin(), value.end(), L'\n', L' ');
+		return value;
+	};
+	auto join = [&](const std::vector<std::wstring> &values)
+	{
+		std::wstring line;
+		for (auto &value : values)
+		{
+			line += L"\t" + clean(value);
+		}
+		return line;
+	};
+
+	std::wstring content = L"FastPageFault results 1\n";
+	for (auto &metadata : _Metadata)
+	{
+		content += L"M\t" + clean(metadata.first) + L"\t" + clean(metadata.second) + L"\n";
+	}
+	for (size_t run = 0; run < _CollectedRuns.size(); run++)
+	{
+		for (auto &table : _CollectedRuns[run])
+		{
+			content += StringExtensions::Format(L"T\t%zu\t", run) + clean(table.Name) + join(table.Columns) + L"\n";
+			content += L"K" + join(table.Keys) + L"\n";
+			for (auto &row : table.Rows)
+			{
+				content += L"R" + join(row) + L"\n";
+			}
+		}
+	}
+
+	Platform::FileHandle hFile = Platform::CreateWriteableFile(file);
+	if (hFile == Platform::InvalidFile)
+	{
+		return false;
+	}
+	std::string narrow = StringExtensions::ToNarrow(content);
+	bool lret = Platform::WriteFile(hFile, narrow.data(), narrow.size());
+	Platform::CloseFile(hFile);
+	return lret;
+}
+
+bool ResultSink::Load(const std::wstring &file, Metadata &metadata, Runs &runs)
+{
+	Platform::FileHandle hFile = Platform::OpenFileForRead(file);
+	if (hFile == Platform::InvalidFile)
+	{
+		return false;
+	}
+
+	size_t size = 0;
+	std::string narrow;
+	Platform::MappingHandle hMapping;
+	void *p = Platform::GetFileSize(hFile, size) && size > 0 ? Platform::MapFile(hFile, size, hMapping) : nullptr;
+	if (p != nullptr)
+	{
+		narrow.assign((const char *)p, size);
+		Platform::UnmapFile(p, size, hMapping);
+	}
+	Platform::CloseFile(hFile);
+
+	std::wstring content = StringExtensions::ToWide(narrow.c_str());
+	if (content.compare(0, 22, L"FastPageFault results ") != 0)
+	{
+		return false;
+	}
+
+	size_t pos = content.find(L'\n');
+	while (pos != std::wstring::npos && pos + 1 < content.size())
+	{
+		size_t end = content.find(L'\n', pos + 1);
+		std::wstring line = content.substr(pos + 1, end == std::wstring::npos ? std::wstring::npos : end - pos - 1);
+		pos = end;
+
+		std::vector<std::wstring> fields = Split(line);
+		std::vector<std::wstring> values(fields.begin() + 1, fields.end());
+		if (fields[0] == L"M" && values.size() == 2)
+		{
+			metadata.push_back(std::make_pair(values[0], values[1]));
+		}
+		else if (fields[0] == L"T" && values.size() >= 2)
+		{
+			size_t run = (size_t)wcstoul(values[0].c_str(), nullptr, 10);
+			if (run >= runs.size())
+			{
+				runs.resize(run + 1);
+			}
+			Table table;
+			table.Name = values[1];
+			table.Columns.assign(values.begin() + 2, values.end());
+			runs[run].push_back(table);
+		}
+		else if (fields[0] == L"K" && !runs.empty() && !runs.back().empty())
+		{
+			runs.back().back().Keys = values;
+		}
+		else if (fields[0] == L"R" && !runs.empty() && !runs.back().empty())
+		{
+			runs.back().back().Rows.push_back(values);
+		}
+	}
+	return true;
+}
+
+// Collect the values of every table, configuration and metric over all runs. Configurations which occur several times
+// in one run are numbered.
+std::vector<ResultSink::Sample> ResultSink::GetSamples(const Runs &runs)
+{
+	std::vector<Sample> lret;
+	std::map<std::wstring, size_t> indices;
+	for (auto &run : runs)
+	{
+		std::map<std::wstring, int> occurrences;
+		for (auto &table : run)
+		{
+			for (size_t r = 0; r < table.Rows.size(); r++)
+			{
+				const std::vector<std::wstring> &row = table.Rows[r];
+				std::vector<size_t> keyIndices;
+				std::wstring configuration = table.Keys.empty() ? StringExtensions::Format(L"Row=%zu", r) : L"";
+				for (auto &key : table.Keys)
+				{
+					auto it = std::find(table.Columns.begin(), table.Columns.end(), key);
+					size_t c = it - table.Columns.begin();
+					if (it != table.Columns.end() && c < row.size())
+					{
+						keyIndices.push_back(c);
+						configuration += (configuration.empty() ? L"" : L" ") + key + L"=" + row[c];
+					}
+				}
+				int occurrence = occurrences[table.Name + L"\t" + configuration]++;
+				if (occurrence > 0)
+				{
+					configuration += StringExtensions::Format(L" #%d", occurrence + 1);
+				}
+
+				for (size_t c = 0; c < table.Columns.size() && c < row.size(); c++)
+				{
+					double number = 0;
+					if (std::find(keyIndices.begin(), keyIndices.end(), c) != keyIndices.end() || !ParseNumber(row[c], number))
+					{
+						continue;
+					}
+
+					std::wstring id = table.Name + L"\t" + configuration + L"\t" + table.Columns[c];
+					auto it = indices.find(id);
+					if (it == indices.end())
+					{
+						Sample sample;
+						sample.Table = table.Name;
+						sample.Configuration = configuration;
+						sample.Metric = table.Columns[c];
+						it = indices.insert(std::make_pair(id, lret.size())).first;
+						lret.push_back(sample);
+					}
+					lret[it->second].Values.push_back(number);
+				}
+			}
+		}
+	}
+	return lret;
+}
+
+int ResultSink::Compare(const std::wstring &baselineFile, const std::wstring &currentFile, double thresholdPercent)
+{
+	Metadata baselineMetadata, currentMetadata;
+	Runs baselineRuns, currentRuns;
+	if (!Load(baselineFile, baselineMetadata, baselineRuns) || !Load(currentFile, currentMetadata, currentRuns))
+	{
+		Message(StringExtensions::Format(L"Error: Could not read the result files %ls and %ls", baselineFile.c_str(), currentFile.c_str()));
+		return -1;
+	}
+
+	// show what is different between both runs e.g. the kernel version or the THP mode
+	for (auto &baseline : baselineMetadata)
+	{
+		for (auto &current : currentMetadata)
+		{
+			if (baseline.first == current.first && baseline.second != current.second)
+			{
+				Message(StringExtensions::Format(L"%ls: %ls -> %ls", baseline.first.c_str(), baseline.second.c_str(), current.second.c_str()));
+			}
+		}
+	}
+
+	std::vector<Sample> baselineSamples = GetSamples(baselineRuns);
+	std::vector<Sample> currentSamples = GetSamples(currentRuns);
+
+	int regressions = 0;
+	BeginTable(L"compare", L"Table\tConfiguration\tMetric\tBaseline\tCurrent\tDelta_%\tp\tResult", L"Table\tConfiguration\tMetric");
+	for (auto &baseline : baselineSamples)
+	{
+		auto current = std::find_if(currentSamples.begin(), currentSamples.end(),
+			[&](const Sample &sample) { return sample.Table == baseline.Table && sample.Configuration == baseline.Configuration && sample.Metric == baseline.Metric; });
+		if (current == currentSamples.end())
+		{
+			AddRow(baseline.Table + L"\t" + baseline.Configuration + L"\t" + baseline.Metric + StringExtensions::Format(L"\t%.3f\tN.a.\tN.a.\tN.a.\tmissing", Mean(baseline.Values)));
+			continue;
+		}
+
+		double baseMean = Mean(baseline.Values);
+		double currentMean = Mean(current->Values);
+		double p = WelchTTest(baseline.Values, current->Values);
+		bool bHigherIsBetter = baseline.Metric.find(L"MB/s") != std::wstring::npos;
+		bool bGated = bHigherIsBetter || baseline.Metric.compare(0, 3, L"p99") == 0;
+		double delta = baseMean == 0 ? 0 : (currentMean - baseMean) * 100 / baseMean;
+		double worse = bHigherIsBetter ? -delta : delta;
+
+		const wchar_t *result = L"";
+		if (bGated && baseMean != 0 && fabs(delta) > thresholdPercent && p < 0.05)
+		{
+			result = worse > 0 ? L"regression" : L"improvement";
+			regressions += worse > 0 ? 1 : 0;
+		}
+
+		AddRow(baseline.Table + L"\t" + baseline.Configuration + L"\t" + baseline.Metric + StringExtensions::Format(L"\t%.3f\t%.3f\t%ls\t%ls\t%ls",
+			baseMean, currentMean, baseMean == 0 ? L"N.a." : StringExtensions::Format(L"%.2f", delta).c_str(),
+			p < 0 ? L"N.a." : StringExtensions::Format(L"%.4f", p).c_str(), result));
+	}
+
+	Message(StringExtensions::Format(L"%d regression(s) of throughput or p99 latency by more than %.1f%%", regressions, thresholdPercent));
+	return regressions;
+}
+
+void ResultSink::Message(const std::wstring &text)
+{
+	if (_Format == Format::Table)
+	{
+		wprintf(L"%ls\n", text.c_str());
+	}
+	else
+	{
+		fwprintf(stderr, L"%ls\n", text.c_str());
+	}
+}
+
+void ResultSink::Flush()
+{
+	if (_Format != Format::Json)
+	{
+		return;
+	}
+
+	std::wstring json = L"{\n  \"metadata\": {";
+	for (size_t i = 0; i < _Metadata.size(); i++)
+	{
+		json += (i == 0 ? L"\n    " : L",\n    ") + JsonString(_Metadata[i].first) + L": " + JsonString(_Metadata[i].second);
+	}
+	json += L"\n  },\n  \"tables\": [";
+
+	for (size_t t = 0; t < _Tables.size(); t++)
+	{
+		const Table &table = _Tables[t];
+		json += (t == 0 ? L"\n    " : L",\n    ");
+		json += L"{ \"name\": " + JsonString(table.Name) + L", \"rows\": [";
+		for (size_t r = 0; r < table.Rows.size(); r++)
+		{
+			json += (r == 0 ? L"\n      { " : L",\n      { ");
+			for (size_t c = 0; c < table.Rows[r].size(); c++)
+			{
+				// rows can have more values than columns e.g. an error text at the end
+				std::wstring column = c < table.Columns.size() ? table.Columns[c] : StringExtensions::Format(L"Column%zu", c);
+				json += (c == 0 ? L"" : L", ") + JsonString(column) + L": " + JsonValue(table.Rows[r][c]);
+			}
+			json += L" }";
+		}
+		json += table.Rows.empty() ? L"] }" : L"\n    ] }";
+	}
+	json += L"\n  ]\n}\n";
+
+	wprintf(L"%ls", json.c_str());
+	_Tables.clear();
+}
+
+std::vector<std::wstring> ResultSink::Split(const std::wstring &line)
+{
+	std::vector<std::wstring> values;
+	size_t pos = 0;
+	while (true)
+	{
+		size_t end = line.find(L'\t', pos);
+		values.push_back(line.substr(pos, end == std::wstring::npos ? std::wstring::npos : end - pos));
+		if (end == std::wstring::npos)
+		{
+			break;
+		}
+		pos = end + 1;
+	}
+	return values;
+}
+
+std::wstring ResultSink::CsvField(const std::wstring &value)
+{
+	if (value.find_first_of(L",\"\n") == std::wstring::npos)
+	{
+		return value;
+	}
+
+	std::wstring lret = L"\"";
+	for (wchar_t c : value)
+	{
+		lret += c == L'"' ? L"\"\"" : std::wstring(1, c);
+	}
+	return lret + L"\"";
+}
+
+std::wstring ResultSink::JsonString(const std::wstring &value)
+{
+	std::wstring lret = L"\"";
+	for (wchar_t c : value)
+	{
+		switch (c)
+		{
+		case L'"': lret += L"\\\""; break;
+		case L'\\': lret += L"\\\\"; break;
+		case L'\n': lret += L"\\n"; break;
+		case L'\t': lret += L"\\t"; break;
+		default:
+			if (c < 0x20)
+			{
+				lret += StringExtensions::Format(L"\\u%04x", (unsigned)c);
+			}
+			else
+			{
+				lret += c;
+			}
+		}
+	}
+	return lret + L"\"";
+}
+
+// Numbers are written as JSON numbers, N.a. as null and everything else as string
+std::wstring ResultSink::JsonValue(const std::wstring &value)
+{
+	if (value == L"N.a.")
+	{
+		return L"null";
+	}
+
+	double number = 0;
+	return ParseNumber(value, number) ? value : JsonString(value);
+}
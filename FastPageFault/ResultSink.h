@@ -0,0 +1,107 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
+// Output of all result tables. The scenarios describe a table by its tab separated column names and add tab separated rows.
+// Table prints them unchanged. Csv prints comma separated rows with the table name and the run metadata in front of every row.
+// Json prints one document with the metadata and all tables when Flush is called. Values which are numbers are written
+// as JSON numbers and N.a. as null. Messages go to stdout for Table and to stderr otherwise to keep stdout machine readable.
+// A scenario can be executed several times. The rows of warm up runs are dropped. With more than one measured run the rows
+// are collected and EndRuns prints per row and metric column the mean, median, standard deviation, min, max and the
+// 95% confidence interval of the mean. Rows of different runs belong together when they have the same position in the same table.
+// The rows of all measured runs can be saved to a file. Compare loads two saved files, matches the rows by table and key
+// columns and reports the change of every metric with a Welch t-test when both files contain several runs.
+class ResultSink
+{
+public:
+	enum class Format
+	{
+		Table = 0,
+		Csv,
+		Json,
+	};
+
+	static bool ParseFormat(const std::wstring &str, Format &format);
+
+	void SetFormat(Format format) { _Format = format; }
+	Format GetFormat() const { return _Format; }
+	void AddMetadata(const std::wstring &key, const std::wstring &value);
+
+	// Start a new table. name identifies the table in the Csv and Json output. keys are the tab separated columns which
+	// identify a configuration. All other numeric columns are metrics for which statistics are calculated.
+	void BeginTable(const std::wstring &name, const std::wstring &columns, const std::wstring &keys = L"");
+	// Add a row of tab separated values to the current table
+	void AddRow(const std::wstring &values);
+	// Free text like warnings and progress information. A trailing newline is added.
+	void Message(const std::wstring &text);
+	// Print the Json document. Does nothing for the other formats.
+	void Flush();
+
+	// Number of measured runs and whether outliers are rejected from the statistics. Outliers are values which are more
+	// than 3 scaled median absolute deviations away from the median.
+	void SetRuns(int runs, bool bRejectOutliers) { _Runs = runs; _bRejectOutliers = bRejectOutliers; }
+	// Start the next run. The rows of warm up runs are not reported.
+	void BeginRun(bool bWarmup);
+	// Print the statistics of all collected runs and save them when a file was set
+	void EndRuns();
+	// Save the metadata and the rows of all measured runs to file when EndRuns is called
+	void SetSaveFile(const std::wstring &file) { _SaveFile = file; }
+
+	// Compare the results of two saved files. A throughput (MB/s) or tail latency (p99) metric has regressed when it
+	// became more than thresholdPercent worse and the difference is significant (p < 0.05) or could not be tested.
+	// Returns the number of regressions or -1 when a file could not be read.
+	int Compare(const std::wstring &baselineFile, const std::wstring &currentFile, double thresholdPercent);
+
+private:
+	struct Table
+	{
+		std::wstring Name;
+		std::vector<std::wstring> Columns;
+		std::vector<std::wstring> Keys;
+		std::vector<std::vector<std::wstring>> Rows;
+	};
+
+	typedef std::vector<std::pair<std::wstring, std::wstring>> Metadata;
+	typedef std::vector<std::vector<Table>> Runs;
+
+	struct Sample
+	{
+		std::wstring Table;
+		std::wstring Configuration;   // key=value of all key columns
+		std::wstring Metric;
+		std::vector<double> Values;   // one value per run
+	};
+
+	struct Statistics
+	{
+		size_t Count = 0;
+		size_t Rejected = 0;
+		double Mean = 0, Median = 0, StdDev = 0, Min = 0, Max = 0, ConfidenceLow = 0, ConfidenceHigh = 0;
+	};
+
+	void PrintHeader(const Table &table);
+	void PrintRow(const Table &table, const std::vector<std::wstring> &values);
+	Statistics Calculate(std::vector<double> values) const;
+	static bool ParseNumber(const std::wstring &value, double &number);
+	static double Mean(const std::vector<double> &values);
+	static double Variance(const std::vector<double> &values);
+	static double WelchTTest(const std::vector<double> &a, const std::vector<double> &b);
+	static double IncompleteBeta(double a, double b, double x);
+	static std::vector<Sample> GetSamples(const Runs &runs);
+	bool Save(const std::wstring &file) const;
+	static bool Load(const std::wstring &file, Metadata &metadata, Runs &runs);
+	static std::vector<std::wstring> Split(const std::wstring &line);
+	static std::wstring CsvField(const std::wstring &value);
+	static std::wstring JsonString(const std::wstring &value);
+	static std::wstring JsonValue(const std::wstring &value);
+
+	Format _Format = Format::Table;
+	Metadata _Metadata;
+	std::vector<Table> _Tables;                         // tables of the Json document
+	int _Runs = 1;
+	bool _bRejectOutliers = false;
+	bool _bWarmup = false;
+	Runs _CollectedRuns;                               // tables of every measured run
+	std::wstring _SaveFile;
+};
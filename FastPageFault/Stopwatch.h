@@ -1,28 +1,107 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
+#include "TickCounter.h"
 
+// Measures elapsed time with ns resolution. By default std::chrono::steady_clock is used which is guaranteed to be monotonic.
+// With Stopwatch::UseTsc(true) the invariant TSC of the CPU is read instead which has a resolution of a few ns and much less
+// call overhead. In both cases the overhead of a Start/Stop pair is measured once and subtracted from every measurement.
 class Stopwatch
 {
 public:
 	Stopwatch()
 	{
-		_Start = std::chrono::high_resolution_clock::now();
+		Start();
 	}
 
 	void Start()
 	{
-		_Start = std::chrono::high_resolution_clock::now();
+		_Start = Now();
 	}
 
-	std::chrono::milliseconds Stop()
+	std::chrono::nanoseconds Stop()
 	{
-		_Stop = std::chrono::high_resolution_clock::now();
-		return std::chrono::duration_cast<std::chrono::milliseconds>(_Stop - _Start);
+		_Stop = Now();
+		int64_t elapsed = (int64_t)(_Stop - _Start) - Overhead();
+		return std::chrono::nanoseconds(ToNs(elapsed < 0 ? 0 : elapsed));
 	}
+
+	// Select the TSC as time source. Returns false if the CPU has no invariant TSC and the steady clock is still used.
+	static bool UseTsc(bool bUseTsc)
+	{
+		Tsc() = bUseTsc && TickCounter::IsTsc();
+		if (Tsc())
+		{
+			TickCounter::TicksPerNs(); // calibrate now and not during the first measurement
+		}
+		Overhead() = MeasureOverhead();
+		return Tsc() == bUseTsc;
+	}
+
+	static bool IsTsc()
+	{
+		return Tsc();
+	}
+
+	static double ToMs(std::chrono::nanoseconds ns)
+	{
+		return ns.count() / 1000000.0;
+	}
+
+	static double ToSeconds(std::chrono::nanoseconds ns)
+	{
+		return ns.count() / 1000000000.0;
+	}
+
 private:
-	std::chrono::high_resolution_clock::time_point _Start;
-	std::chrono::high_resolution_clock::time_point _Stop;
-};
+	static bool &Tsc()
+	{
+		static bool bTsc = false;
+		return bTsc;
+	}
+
+	// Raw timestamp in TSC ticks or steady clock ns
+	static uint64_t Now()
+	{
+		if (Tsc())
+		{
+			return TickCounter::Now();
+		}
+		return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+	}
+
+	static int64_t ToNs(int64_t ticks)
+	{
+		if (Tsc())
+		{
+			return (int64_t)TickCounter::ToNs((uint64_t)ticks);
+		}
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::duration(ticks)).count();
+	}
 
+	// Minimum of many back to back Now() calls is the fixed cost included in every measurement
+	static int64_t MeasureOverhead()
+	{
+		int64_t minTicks = INT64_MAX;
+		for (int i = 0; i < 1000; i++)
+		{
+			uint64_t start = Now();
+			uint64_t stop = Now();
+			if ((int64_t)(stop - start) < minTicks)
+			{
+				minTicks = (int64_t)(stop - start);
+			}
+		}
+		return minTicks;
+	}
 
+	static int64_t &Overhead()
+	{
+		static int64_t overhead = MeasureOverhead();
+		return overhead;
+	}
+
+	uint64_t _Start;
+	uint64_t _Stop;
+};
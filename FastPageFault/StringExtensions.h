@@ -3,6 +3,10 @@
 #include <iostream>
 #include <string>
 #include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <cstring>
+#include <vector>
 
 #pragma warning(disable : 4996)
 
@@ -12,13 +16,63 @@ public:
 	template<typename ... Args>
 	static std::wstring Format(const wchar_t  *pFormat, Args ... args)
 	{
+#ifdef _WIN32
 		size_t size = _snwprintf(nullptr, 0, pFormat, args ...) + 1; // Extra space for '\0'
 		std::unique_ptr<wchar_t[]> buf(new wchar_t[size]);
 		_snwprintf(buf.get(), size, pFormat, args ...);
 		return std::wstring(buf.get(), buf.get() + size - 1); // We don't want the '\0' inside
+#else
+		// swprintf does not return the required size when the buffer is too small. Grow until it fits.
+		for (size_t size = 256; ; size *= 2)
+		{
+			std::unique_ptr<wchar_t[]> buf(new wchar_t[size]);
+			int len = swprintf(buf.get(), size, pFormat, args ...);
+			if (len >= 0 && (size_t)len < size)
+			{
+				return std::wstring(buf.get(), buf.get() + len);
+			}
+		}
+#endif
+	}
+
+	// Convert a wide string to the multibyte encoding of the current locale (e.g. to pass file names to POSIX APIs)
+	static std::string ToNarrow(const std::wstring &str)
+	{
+		size_t size = wcstombs(nullptr, str.c_str(), 0);
+		if (size == (size_t)-1)
+		{
+			return std::string(str.begin(), str.end());
+		}
+		std::string lret(size, '\0');
+		wcstombs(&lret[0], str.c_str(), size);
+		return lret;
+	}
+
+	// Split a comma separated list e.g. "read,pread" into its entries
+	static std::vector<std::wstring> SplitList(const std::wstring &list)
+	{
+		std::vector<std::wstring> entries;
+		for (size_t pos = 0; pos != std::wstring::npos; )
+		{
+			size_t end = list.find(L',', pos);
+			entries.push_back(list.substr(pos, end == std::wstring::npos ? std::wstring::npos : end - pos));
+			pos = end == std::wstring::npos ? end : end + 1;
+		}
+		return entries;
+	}
+
+	static std::wstring ToWide(const char *str)
+	{
+		size_t size = mbstowcs(nullptr, str, 0);
+		if (size == (size_t)-1)
+		{
+			return std::wstring(str, str + strlen(str));
+		}
+		std::wstring lret(size, L'\0');
+		mbstowcs(&lret[0], str, size);
+		return lret;
 	}
 
 	StringExtensions();
 	~StringExtensions();
 };
-
@@ -0,0 +1,174 @@
+#include "stdafx.h"
+#include "TestData.h"
+#include "WorkerPool.h"
+#include <atomic>
+#include <cstring>
+
+static const size_t ChunkBytes = 1024 * 1024;
+static const size_t BlockBytes = 4096;
+
+// xoshiro256+ with 4 independent streams. The streams are updated in lock step so that the compiler can keep the state
+// in vector registers. The lowest bits of xoshiro256+ are weak which does not matter for test data.
+class Xoshiro256x4
+{
+public:
+	explicit Xoshiro256x4(uint64_t seed)
+	{
+		// splitmix64 expands the seed to the state of all streams
+		for (int word = 0; word < 4; word++)
+		{
+			for (int lane = 0; lane < 4; lane++)
+			{
+				seed += 0x9e3779b97f4a7c15ULL;
+				uint64_t z = seed;
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+				_State[word][lane] = z ^ (z >> 31);
+			}
+		}
+	}
+
+	// n must be a multiple of 4
+	void Fill(uint64_t *p, size_t n)
+	{
+		for (size_t i = 0; i < n; i += 4)
+		{
+			for (int lane = 0; lane < 4; lane++)
+			{
+				p[i + lane] = _State[0][lane] + _State[3][lane];
+				uint64_t t = _State[1][lane] << 17;
+				_State[2][lane] ^= _State[0][lane];
+				_State[3][lane] ^= _State[1][lane];
+				_State[1][lane] ^= _State[2][lane];
+				_State[0][lane] ^= _State[3][lane];
+				_State[2][lane] ^= t;
+				_State[3][lane] = (_State[3][lane] << 45) | (_State[3][lane] >> 19);
+			}
+		}
+	}
+
+private:
+	uint64_t _State[4][4];
+};
+
+bool TestData::Parse(const std::wstring &str, Options &options)
+{
+	size_t pos = str.find(L':');
+	std::wstring name = str.substr(0, pos);
+	double value = 0;
+	if (pos != std::wstring::npos)
+	{
+		wchar_t *pEnd = nullptr;
+		value = wcstod(str.c_str() + pos + 1, &pEnd);
+		if (*pEnd != 0)
+		{
+			return false;
+		}
+	}
+
+	if (name == L"random") { options.Content = Profile::Random; }
+	else if (name == L"zero") { options.Content = Profile::Zero; }
+	else if (name == L"compressible")
+	{
+		options.Content = Profile::Compressible;
+		options.Ratio = pos == std::wstring::npos ? 2 : value;
+		return options.Ratio >= 1;
+	}
+	else if (name == L"sparse")
+	{
+		options.Content = Profile::Sparse;
+		options.DataPercent = pos == std::wstring::npos ? 50 : value;
+		return options.DataPercent >= 0 && options.DataPercent <= 100;
+	}
+	else
+	{
+		return false;
+	}
+	return pos == std::wstring::npos;
+}
+
+std::wstring TestData::ToString(const Options &options)
+{
+	switch (options.Content)
+	{
+	case Profile::Zero: return L"zero";
+	case Profile::Compressible: return StringExtensions::Format(L"compressible:%g", options.Ratio);
+	case Profile::Sparse: return StringExtensions::Format(L"sparse:%g", options.DataPercent);
+	default: return L"random";
+	}
+}
+
+// The data chunks are spread evenly over the file
+bool TestData::IsDataChunk(uint64_t chunk, double dataPercent)
+{
+	return (uint64_t)((chunk + 1) * dataPercent / 100) > (uint64_t)(chunk * dataPercent / 100);
+}
+
+void TestData::FillChunk(unsigned char *p, size_t n, uint64_t chunk, const Options &options)
+{
+	if (options.Content == Profile::Zero)
+	{
+		memset(p, 0, n);
+		return;
+	}
+
+	Xoshiro256x4 random(options.Seed ^ (chunk * 0x9e3779b97f4a7c15ULL));
+	random.Fill((uint64_t *)p, n / sizeof(uint64_t) / 4 * 4);
+	if (options.Content == Profile::Compressible)
+	{
+		size_t randomBytes = (size_t)(BlockBytes / options.Ratio);
+		for (size_t block = 0; block < n; block += BlockBytes)
+		{
+			memset(p + block + randomBytes, 0, BlockBytes - randomBytes);
+		}
+	}
+}
+
+int TestData::Create(const std::wstring &file, uint64_t size, const Options &options)
+{
+	Platform::FileHandle hFile = Platform::CreateWriteableFile(file);
+	if (hFile == Platform::InvalidFile)
+	{
+		return Platform::GetLastError();
+	}
+
+	// A sparse file gets its size first and only the data chunks are written. All other files are preallocated
+	// which is not supported by all file systems and only an optimization.
+	bool bSparse = options.Content == Profile::Sparse;
+	if (bSparse && !Platform::SetFileSize(hFile, size, true))
+	{
+		int error = Platform::GetLastError();
+		Platform::CloseFile(hFile);
+		return error;
+	}
+	if (!bSparse)
+	{
+		Platform::PreallocateFile(hFile, size);
+	}
+
+	const uint64_t chunks = (size + ChunkBytes - 1) / ChunkBytes;
+	std::atomic<uint64_t> nextChunk(0);
+	std::atomic<int> error(0);
+	WorkerPool pool(options.Threads, [](int) { return 0; });
+	pool.Run(options.Threads, [&](int)
+	{
+		std::vector<uint64_t> buffer(ChunkBytes / sizeof(uint64_t));
+		for (uint64_t chunk = nextChunk++; chunk < chunks && error == 0; chunk = nextChunk++)
+		{
+			if (bSparse && !IsDataChunk(chunk, options.DataPercent))
+			{
+				continue;
+			}
+
+			size_t n = (size_t)(std::min)((uint64_t)ChunkBytes, size - chunk * ChunkBytes);
+			FillChunk((unsigned char *)buffer.data(), ChunkBytes, chunk, options);
+			if (!Platform::WriteFileAt(hFile, buffer.data(), n, chunk * ChunkBytes))
+			{
+				error = Platform::GetLastError();
+			}
+		}
+	});
+
+	Platform::CloseFile(hFile);
+	return error;
+}
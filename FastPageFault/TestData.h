@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Fast parallel generation of test data files. Every 1 MB chunk is generated from its own seed, so the file content does
+// not depend on the number of threads. The threads write their chunks at their file offsets into the preallocated file.
+class TestData
+{
+public:
+	enum class Profile
+	{
+		Random = 0,      // incompressible random data
+		Zero,            // allocated blocks which contain only zeros
+		Compressible,    // every 4 KB block has 1/Ratio random bytes and zeros otherwise
+		Sparse,          // DataPercent of the 1 MB chunks contain random data, the others are holes without disk space
+	};
+
+	struct Options
+	{
+		Profile Content = Profile::Random;
+		double Ratio = 2;          // Compressible
+		double DataPercent = 50;   // Sparse
+		int Threads = 1;
+		uint64_t Seed = 0x5eed;
+	};
+
+	// Parse random, zero, compressible[:ratio] or sparse[:datapercent]
+	static bool Parse(const std::wstring &str, Options &options);
+	static std::wstring ToString(const Options &options);
+
+	// Create the file with size bytes. Returns 0 or the error code of the first failed call.
+	static int Create(const std::wstring &file, uint64_t size, const Options &options);
+
+private:
+	static bool IsDataChunk(uint64_t chunk, double dataPercent);
+	static void FillChunk(unsigned char *p, size_t n, uint64_t chunk, const Options &options);
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define FASTPAGEFAULT_HAS_TSC 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#include <cpuid.h>
+#define FASTPAGEFAULT_HAS_TSC 1
+#endif
+
+// Cheap timestamp source to time single page faults. On x86 CPUs with an invariant TSC
+// we read the time stamp counter directly which costs ~20 cycles. Otherwise the steady clock
+// (QueryPerformanceCounter / clock_gettime(CLOCK_MONOTONIC)) is used where one tick is one ns.
+// The TSC frequency is calibrated once against the steady clock on first use.
+struct TickCounter
+{
+	static uint64_t Now()
+	{
+#ifdef FASTPAGEFAULT_HAS_TSC
+		if (IsTsc())
+		{
+			unsigned int aux;
+			return __rdtscp(&aux); // waits until all previous instructions (the page touch) have completed
+		}
+#endif
+		return SteadyNowNs();
+	}
+
+	static double ToNs(uint64_t ticks)
+	{
+		return ticks / TicksPerNs();
+	}
+
+	static double TicksPerNs()
+	{
+		static const double ticksPerNs = Calibrate();
+		return ticksPerNs;
+	}
+
+	static bool IsTsc()
+	{
+		static const bool bTsc = HasInvariantTsc();
+		return bTsc;
+	}
+
+private:
+	static uint64_t SteadyNowNs()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static bool HasInvariantTsc()
+	{
+#if defined(FASTPAGEFAULT_HAS_TSC) && defined(_MSC_VER)
+		int regs[4];
+		__cpuid(regs, 0x80000000);
+		if ((unsigned int)regs[0] < 0x80000007)
+		{
+			return false;
+		}
+		__cpuid(regs, 0x80000007);
+		return (regs[3] & (1 << 8)) != 0;
+#elif defined(FASTPAGEFAULT_HAS_TSC)
+		unsigned int eax, ebx, ecx, edx;
+		if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007 || !__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+		{
+			return false;
+		}
+		return (edx & (1 << 8)) != 0;
+#else
+		return false;
+#endif
+	}
+
+	// Measure the TSC frequency over 50ms against the steady clock
+	static double Calibrate()
+	{
+		if (!IsTsc())
+		{
+			return 1.0;
+		}
+
+		uint64_t startNs = SteadyNowNs();
+		uint64_t startTicks = Now();
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		uint64_t stopNs = SteadyNowNs();
+		uint64_t stopTicks = Now();
+
+		return (double)(stopTicks - startTicks) / (double)(stopNs - startNs);
+	}
+};
@@ -0,0 +1,131 @@
+#include "stdafx.h"
+#include "WorkerPool.h"
+#include "TickCounter.h"
+
+WorkerPool::WorkerPool(int threadCount, std::function<int(int threadIndex)> pinThread)
+	: _Nodes(threadCount, -1), _Timings(threadCount), _Arrived(0)
+{
+	for (int i = 0; i < threadCount; i++)
+	{
+		_Threads.push_back(std::thread([=] { WorkerLoop(i, pinThread); }));
+	}
+
+	// wait until all workers are pinned so that the first Run does not include the startup
+	Run(threadCount, [](int) {});
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(_Lock);
+		_bShutdown = true;
+	}
+	_WorkAvailable.notify_all();
+
+	for (auto &t : _Threads)
+	{
+		t.join();
+	}
+}
+
+void WorkerPool::Run(int nThreads, std::function<void(int threadIndex)> work)
+{
+	if (nThreads > GetThreadCount())
+	{
+		nThreads = GetThreadCount();
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(_Lock);
+		_Work = work;
+		_ActiveThreads = nThreads;
+		_Finished = 0;
+		_Arrived = 0;
+		_Generation++;
+	}
+	_WorkAvailable.notify_all();
+
+	std::unique_lock<std::mutex> lock(_Lock);
+	_WorkDone.wait(lock, [&] { return _Finished == _ActiveThreads; });
+}
+
+void WorkerPool::WorkerLoop(int threadIndex, std::function<int(int)> pinThread)
+{
+	_Nodes[threadIndex] = pinThread(threadIndex);
+
+	uint64_t seenGeneration = 0;
+	while (true)
+	{
+		std::function<void(int)> work;
+		int activeThreads = 0;
+		{
+			std::unique_lock<std::mutex> lock(_Lock);
+			_WorkAvailable.wait(lock, [&] { return _bShutdown || (_Generation != seenGeneration && threadIndex < _ActiveThreads); });
+			if (_bShutdown)
+			{
+				return;
+			}
+			seenGeneration = _Generation;
+			work = _Work;
+			activeThreads = _ActiveThreads;
+		}
+
+		// The condition variable wakes the threads up one after the other. Spin until all participating threads are awake
+		// so that they start at the same time.
+		_Arrived.fetch_add(1);
+		while (_Arrived.load() < activeThreads)
+		{
+			std::this_thread::yield(); // let sleeping workers run when there are more threads than cores
+		}
+
+		Timing &timing = _Timings[threadIndex];
+		timing.Start = TickCounter::Now();
+		work(threadIndex);
+		timing.End = TickCounter::Now();
+
+		{
+			std::lock_guard<std::mutex> guard(_Lock);
+			_Finished++;
+		}
+		_WorkDone.notify_one();
+	}
+}
+
+std::chrono::nanoseconds WorkerPool::GetThreadTime(int threadIndex) const
+{
+	const Timing &timing = _Timings[threadIndex];
+	return std::chrono::nanoseconds((int64_t)TickCounter::ToNs(timing.End - timing.Start));
+}
+
+std::chrono::nanoseconds WorkerPool::GetWallTime() const
+{
+	uint64_t firstStart = UINT64_MAX, lastEnd = 0;
+	for (int i = 0; i < _ActiveThreads; i++)
+	{
+		firstStart = (std::min)(firstStart, _Timings[i].Start);
+		lastEnd = (std::max)(lastEnd, _Timings[i].End);
+	}
+	return _ActiveThreads == 0 ? std::chrono::nanoseconds(0) : std::chrono::nanoseconds((int64_t)TickCounter::ToNs(lastEnd - firstStart));
+}
+
+std::chrono::nanoseconds WorkerPool::GetStartSkew() const
+{
+	uint64_t first = UINT64_MAX, last = 0;
+	for (int i = 0; i < _ActiveThreads; i++)
+	{
+		first = (std::min)(first, _Timings[i].Start);
+		last = (std::max)(last, _Timings[i].Start);
+	}
+	return _ActiveThreads == 0 ? std::chrono::nanoseconds(0) : std::chrono::nanoseconds((int64_t)TickCounter::ToNs(last - first));
+}
+
+std::chrono::nanoseconds WorkerPool::GetEndSkew() const
+{
+	uint64_t first = UINT64_MAX, last = 0;
+	for (int i = 0; i < _ActiveThreads; i++)
+	{
+		first = (std::min)(first, _Timings[i].End);
+		last = (std::max)(last, _Timings[i].End);
+	}
+	return _ActiveThreads == 0 ? std::chrono::nanoseconds(0) : std::chrono::nanoseconds((int64_t)TickCounter::ToNs(last - first));
+}
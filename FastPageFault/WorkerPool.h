@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads for all parallel scenarios. Thread creation is no longer part of the measured time
+// and all workers of a Run pass a spin barrier before they start working so that they start faulting at the same instant.
+// Every worker records its own start and end timestamp which are used to calculate the wall time and the skew between threads.
+class WorkerPool
+{
+public:
+	struct Timing
+	{
+		uint64_t Start = 0;   // TickCounter ticks after the start barrier
+		uint64_t End = 0;     // TickCounter ticks after the work has finished
+	};
+
+	// pinThread is called once on every worker thread with its index before any work is dispatched and returns the NUMA node of the thread
+	WorkerPool(int threadCount, std::function<int(int threadIndex)> pinThread);
+	~WorkerPool();
+
+	// Execute work(threadIndex) on the first nThreads workers and wait until all have finished
+	void Run(int nThreads, std::function<void(int threadIndex)> work);
+
+	int GetThreadCount() const { return (int)_Threads.size(); }
+	int GetNode(int threadIndex) const { return _Nodes[threadIndex]; }
+	const Timing &GetTiming(int threadIndex) const { return _Timings[threadIndex]; }
+
+	// Results of the last Run
+	std::chrono::nanoseconds GetThreadTime(int threadIndex) const;
+	std::chrono::nanoseconds GetWallTime() const;      // first start until last end
+	std::chrono::nanoseconds GetStartSkew() const;     // first start until last start
+	std::chrono::nanoseconds GetEndSkew() const;       // first end until last end
+
+private:
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	void WorkerLoop(int threadIndex, std::function<int(int)> pinThread);
+
+	std::vector<std::thread> _Threads;
+	std::vector<int> _Nodes;
+	std::vector<Timing> _Timings;
+
+	std::mutex _Lock;
+	std::condition_variable _WorkAvailable;
+	std::condition_variable _WorkDone;
+	uint64_t _Generation = 0;
+	bool _bShutdown = false;
+	int _ActiveThreads = 0;
+	int _Finished = 0;
+	std::function<void(int)> _Work;
+
+	std::atomic<int> _Arrived;  // spin barrier for the synchronized start
+};
@@ -5,16 +5,23 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include "targetver.h"
 
-#include <stdio.h>
 #include <tchar.h>
 #include <windows.h>
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
 
 #include <map>
 #include <thread>
 #include <functional>
+#include <vector>
+#include <algorithm>
 
+#include "Platform.h"
 #include "FileExtensions.h"
 #include "StringExtensions.h"
 #include "MemoryMappedFile.h"